@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <ultra240/concurrent_vector_allocator.h>
+
+/**
+ * Concurrent allocator stress test.
+ *
+ * Threads repeatedly build and prune lists sharing one concurrent vector
+ * allocator, trading lists with each other between rounds. Every node holds
+ * a value derived from its thread and position so that a slot handed to two
+ * lists at once is detected when the lists are compared with their expected
+ * contents. The same workload is then run by waves of short lived threads,
+ * many more than the threads with a cache, after which the whole store must
+ * be allocatable again, as exited threads return the slots they cached. The
+ * workload is then timed with the standard allocator. Results are written to
+ * stdout as one JSON object per line, and the exit status is nonzero if a
+ * list was corrupted or the store ran out.
+ *
+ * Usage: allocator [threads] [rounds]
+ */
+
+using namespace ultra;
+
+static const size_t max_list_size = 1024;
+
+// A list and its expected contents, exchanged between threads so that nodes
+// are freed by threads other than the one that allocated them.
+template <typename List>
+struct Mailbox {
+  Mailbox(const typename List::allocator_type& allocator)
+    : list(allocator) {}
+
+  std::mutex mutex;
+  List list;
+  std::vector<uint32_t> expected;
+};
+
+template <typename List>
+static bool run(
+  List& list,
+  std::deque<Mailbox<List>>& mailboxes,
+  size_t thread,
+  size_t rounds
+) {
+  std::mt19937 rng(thread);
+  std::uniform_int_distribution<size_t> size(1, max_list_size);
+  std::vector<uint32_t> expected;
+  for (size_t round = 0; round < rounds; round++) {
+    // Grow the list with values unique to the thread and round.
+    size_t count = size(rng);
+    for (size_t i = 0; i < count; i++) {
+      uint32_t value = (thread << 24) | ((round & 0xff) << 16) | i;
+      list.push_back(value);
+      expected.push_back(value);
+    }
+    // Prune every other element, then the back half.
+    bool erase = false;
+    for (auto it = list.begin(); it != list.end(); erase = !erase) {
+      it = erase ? list.erase(it) : std::next(it);
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < expected.size(); i += 2) {
+      expected[kept++] = expected[i];
+    }
+    expected.resize(kept / 2);
+    list.resize(kept / 2);
+    if (!std::equal(list.begin(), list.end(), expected.begin())) {
+      return false;
+    }
+    // Trade lists with another thread.
+    auto& mailbox = mailboxes[(thread + round) % mailboxes.size()];
+    std::lock_guard<std::mutex> lock(mailbox.mutex);
+    list.swap(mailbox.list);
+    expected.swap(mailbox.expected);
+  }
+  return true;
+}
+
+template <typename F>
+static double measure(size_t threads_count, F work) {
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < threads_count; i++) {
+    threads.emplace_back(work, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void report(
+  const char* allocator,
+  size_t threads_count,
+  size_t rounds,
+  double ms
+) {
+  printf(
+    "{\"allocator\": \"%s\", \"threads\": %zu, \"rounds\": %zu, "
+    "\"ms\": %.1f}\n",
+    allocator,
+    threads_count,
+    rounds,
+    ms
+  );
+  fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+  size_t threads_count = std::max(4u, std::thread::hardware_concurrency());
+  size_t rounds = 2000;
+  if (argc > 1) {
+    threads_count = strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    rounds = strtoul(argv[2], nullptr, 10);
+  }
+  // Each list and mailbox holds at most its maximum size plus the previous
+  // remainder, and each thread may cache some slots.
+  size_t capacity =
+    threads_count * (4 * max_list_size + ConcurrentPool::cache_size);
+  ConcurrentVectorAllocator<uint32_t> allocator(capacity);
+  std::atomic<bool> corrupted(false);
+  std::atomic<bool> exhausted(false);
+  {
+    using List = ConcurrentVectorAllocatorList<uint32_t>;
+    std::deque<Mailbox<List>> mailboxes;
+    for (size_t i = 0; i < threads_count; i++) {
+      mailboxes.emplace_back(allocator);
+    }
+    double ms = measure(threads_count, [&](size_t thread) {
+      List list(allocator);
+      if (!run(list, mailboxes, thread, rounds)) {
+        corrupted = true;
+      }
+    });
+    report("concurrent_vector", threads_count, rounds, ms);
+  }
+  {
+    // Lists outlive the threads of a wave in the mailboxes.
+    using List = ConcurrentVectorAllocatorList<uint32_t>;
+    std::deque<Mailbox<List>> mailboxes;
+    for (size_t i = 0; i < threads_count; i++) {
+      mailboxes.emplace_back(allocator);
+    }
+    size_t waves = 4 * ConcurrentPool::max_threads / threads_count + 1;
+    size_t wave_rounds = std::max<size_t>(rounds / waves, 1);
+    double ms = 0;
+    for (size_t wave = 0; wave < waves; wave++) {
+      ms += measure(threads_count, [&](size_t thread) {
+        try {
+          List list(allocator);
+          if (!run(list, mailboxes, thread, wave_rounds)) {
+            corrupted = true;
+          }
+        } catch (const std::bad_alloc&) {
+          exhausted = true;
+        }
+      });
+    }
+    report("concurrent_vector_churn", threads_count, waves * wave_rounds, ms);
+    // Every slot is free once the lists are, wherever it was cached.
+    for (auto& mailbox : mailboxes) {
+      mailbox.list.clear();
+    }
+    try {
+      List list(allocator);
+      for (size_t i = 0; i < capacity; i++) {
+        list.push_back(i);
+      }
+    } catch (const std::bad_alloc&) {
+      exhausted = true;
+    }
+  }
+  {
+    using List = std::list<uint32_t>;
+    std::deque<Mailbox<List>> mailboxes;
+    for (size_t i = 0; i < threads_count; i++) {
+      mailboxes.emplace_back(List::allocator_type());
+    }
+    double ms = measure(threads_count, [&](size_t thread) {
+      List list;
+      run(list, mailboxes, thread, rounds);
+    });
+    report("std", threads_count, rounds, ms);
+  }
+  if (corrupted) {
+    fprintf(stderr, "list corrupted by concurrent allocation\n");
+    return 1;
+  }
+  if (exhausted) {
+    fprintf(stderr, "store exhausted by slots cached by exited threads\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include <ultra240/world.h>
+
+/**
+ * Collision benchmark.
+ *
+ * Synthetic worlds are generated in memory and the boundary collision and
+ * collision box fit queries are timed against them for each force direction
+ * and collision box count, with and without a distance field. Results are
+ * written to stdout as one JSON object per line.
+ *
+ * Usage: collision [max segments]
+ */
+
+using namespace ultra;
+
+using Box = Tileset::Tile::CollisionBox<float>;
+
+using Vector = geometry::Vector<float>;
+
+struct Direction {
+  const char* name;
+  Vector force;
+};
+
+static const Direction directions[] = {
+  {"right", {4, 0}},
+  {"left", {-4, 0}},
+  {"down", {0, 4}},
+  {"up", {0, -4}},
+  {"down_right", {3, 3}},
+  {"down_left", {-3, 3}},
+  {"up_right", {3, -3}},
+  {"up_left", {-3, -3}},
+};
+
+static const size_t max_boxes_count = 3;
+
+struct Scenario {
+  const char* name;
+  std::function<void(std::vector<World::Boundary>&, size_t)> generate;
+};
+
+static void generate_floor(std::vector<World::Boundary>& segments, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    float x = i * 16;
+    segments.emplace_back(Vector(x, 0), Vector(x + 16, 0));
+  }
+}
+
+static void generate_stairs(std::vector<World::Boundary>& segments, size_t n) {
+  float x = 0, y = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i % 2 == 0) {
+      segments.emplace_back(Vector(x, y), Vector(x + 16, y));
+      x += 16;
+    } else {
+      segments.emplace_back(Vector(x, y), Vector(x, y - 8));
+      y -= 8;
+    }
+  }
+}
+
+static void generate_slopes(std::vector<World::Boundary>& segments, size_t n) {
+  static const Vector steps[] = {{16, -16}, {32, -16}, {32, 16}, {16, 16}};
+  Vector p(0, 0);
+  for (size_t i = 0; i < n; i++) {
+    Vector q = p + steps[i % 4];
+    segments.emplace_back(p, q);
+    p = q;
+  }
+}
+
+static void generate_platforms(
+  std::vector<World::Boundary>& segments,
+  size_t n
+) {
+  size_t columns = 64;
+  for (size_t i = 0; i < n; i++) {
+    float x = (i % columns) * 48 + (i / columns % 2) * 24;
+    float y = (i / columns) * -32.f;
+    segments.emplace_back(
+      World::Boundary::Flags::OneWay,
+      Vector(x, y),
+      Vector(x + 32, y)
+    );
+  }
+}
+
+static const Scenario scenarios[] = {
+  {"floor", generate_floor},
+  {"stairs", generate_stairs},
+  {"slopes", generate_slopes},
+  {"platforms", generate_platforms},
+};
+
+struct Query {
+  Box prev[max_boxes_count];
+  Box next[max_boxes_count];
+};
+
+static std::vector<Query> make_queries(
+  const std::vector<World::Boundary>& segments,
+  size_t count,
+  std::mt19937& rng
+) {
+  std::uniform_int_distribution<size_t> segment(0, segments.size() - 1);
+  std::uniform_real_distribution<float> offset(-12, 12);
+  std::uniform_int_distribution<int> size(8, 24);
+  std::vector<Query> queries(count);
+  for (auto& query : queries) {
+    // Place the collision boxes right above a random segment so queries hit
+    // nearby geometry as they would in a game.
+    auto& boundary = segments[segment(rng)];
+    Vector position(
+      std::min(boundary.p.x, boundary.q.x) + offset(rng),
+      std::min(boundary.p.y, boundary.q.y) - 32 + offset(rng)
+    );
+    for (size_t i = 0; i < max_boxes_count; i++) {
+      Vector box_size(size(rng), size(rng));
+      Vector box_position = position + Vector(i * 4, 32 - box_size.y);
+      query.prev[i] = Box(i + 1, box_position, box_size);
+      query.next[i] = Box(
+        i + 1,
+        box_position + Vector(offset(rng) / 4, 0),
+        box_size + Vector(0, offset(rng) / 4)
+      );
+    }
+  }
+  return queries;
+}
+
+static void report(
+  const char* scenario,
+  size_t segments_count,
+  const char* query,
+  const char* direction,
+  size_t boxes_count,
+  std::vector<uint64_t>& samples
+) {
+  uint64_t total = 0;
+  for (auto sample : samples) {
+    total += sample;
+  }
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&samples](size_t p) {
+    return samples[std::min(samples.size() - 1, samples.size() * p / 100)];
+  };
+  printf(
+    "{\"scenario\": \"%s\", \"segments\": %zu, \"query\": \"%s\", "
+    "\"direction\": \"%s\", \"boxes\": %zu, \"queries\": %zu, "
+    "\"ns_per_query\": %.1f, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+    "\"p99_ns\": %llu, \"max_ns\": %llu}\n",
+    scenario,
+    segments_count,
+    query,
+    direction,
+    boxes_count,
+    samples.size(),
+    static_cast<double>(total) / samples.size(),
+    static_cast<unsigned long long>(percentile(50)),
+    static_cast<unsigned long long>(percentile(90)),
+    static_cast<unsigned long long>(percentile(99)),
+    static_cast<unsigned long long>(samples.back())
+  );
+  fflush(stdout);
+}
+
+template <typename F>
+static std::vector<uint64_t> measure(size_t count, F query) {
+  std::vector<uint64_t> samples(count);
+  for (size_t i = 0; i < count; i++) {
+    auto start = std::chrono::steady_clock::now();
+    query(i);
+    auto end = std::chrono::steady_clock::now();
+    samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start
+    ).count();
+  }
+  return samples;
+}
+
+int main(int argc, char* argv[]) {
+  size_t max_segments_count = 100000;
+  if (argc > 1) {
+    max_segments_count = strtoul(argv[1], nullptr, 10);
+  }
+  volatile size_t sink = 0;
+  std::mt19937 rng(240);
+  for (auto& scenario : scenarios) {
+    for (size_t n = 1000; n <= max_segments_count; n *= 10) {
+      std::vector<World::Boundary> segments;
+      segments.reserve(n);
+      scenario.generate(segments, n);
+      World::Boundaries boundaries(segments.size());
+      for (auto& segment : segments) {
+        boundaries.push_back(segment);
+      }
+      World::DistanceField distance_field(boundaries);
+      size_t count = std::max<size_t>(32, 1000000 / n);
+      auto queries = make_queries(segments, count, rng);
+      for (auto& direction : directions) {
+        for (size_t boxes_count = 1;
+             boxes_count <= max_boxes_count;
+             boxes_count++) {
+          auto samples = measure(count, [&](size_t i) {
+            auto collision = World::get_boundary_collision(
+              direction.force,
+              queries[i].prev,
+              boxes_count,
+              boundaries
+            );
+            sink = sink + collision.first;
+          });
+          report(
+            scenario.name,
+            n,
+            "get_boundary_collision",
+            direction.name,
+            boxes_count,
+            samples
+          );
+          samples = measure(count, [&](size_t i) {
+            auto collision = World::get_boundary_collision(
+              direction.force,
+              queries[i].prev,
+              boxes_count,
+              boundaries,
+              distance_field
+            );
+            sink = sink + collision.first;
+          });
+          report(
+            scenario.name,
+            n,
+            "get_boundary_collision_distance_field",
+            direction.name,
+            boxes_count,
+            samples
+          );
+        }
+      }
+      for (size_t boxes_count = 1;
+           boxes_count <= max_boxes_count;
+           boxes_count++) {
+        auto samples = measure(count, [&](size_t i) {
+          auto fit = World::can_fit_collision_boxes(
+            queries[i].prev,
+            boxes_count,
+            queries[i].next,
+            boxes_count,
+            boundaries,
+            true
+          );
+          sink = sink + fit.first;
+        });
+        report(
+          scenario.name,
+          n,
+          "can_fit_collision_boxes",
+          "none",
+          boxes_count,
+          samples
+        );
+      }
+    }
+  }
+  return 0;
+}
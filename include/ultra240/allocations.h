@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ultra::allocations {
+
+  /**
+   * Allocation categories.
+   *
+   * Heap allocations are attributed to the category of the innermost scope
+   * open on the allocating thread, or to `Other` outside of any scope.
+   */
+  enum class Category : uint8_t {
+
+    /** Allocations outside of any other category. */
+    Other,
+
+    /** Collision queries of `World`. */
+    Collision,
+
+    /** Map and sprite transform generation of the renderer. */
+    Transforms,
+
+    /** Animation updates of `AnimatedSprite`. */
+    Animation,
+
+    /** Entity creation by `Entity::Factory`. */
+    Entities,
+  };
+
+  /** Count of allocation categories. */
+  inline constexpr size_t categories_count = 5;
+
+  /** Allocation statistics of a category. */
+  struct Stats {
+
+    /** Count of heap allocations. */
+    uint32_t count;
+
+    /** Count of bytes requested by heap allocations. */
+    uint64_t bytes;
+  };
+
+  /**
+   * Return true if the library is configured with
+   * `--enable-allocation-tracking`, otherwise every count is zero.
+   *
+   * When enabled, the global `operator new` is replaced so that every heap
+   * allocation of the process is counted.
+   */
+  bool is_enabled();
+
+  /**
+   * Get the allocation statistics of a category accumulated since the start
+   * of the current frame.
+   *
+   * The difference of two results can be used to attribute allocations to
+   * the calls made in between.
+   */
+  Stats get_stats(Category category);
+
+  /** Get the allocation statistics of a category for the previous frame. */
+  Stats get_frame_stats(Category category);
+
+  /**
+   * Allocation scope class.
+   *
+   * Allocations made by the calling thread while a scope exists are
+   * attributed to its category. Scopes may be nested.
+   */
+  class Scope {
+  public:
+
+    /** Open a scope of the specified category. */
+    Scope(Category category);
+
+    Scope(const Scope&) = delete;
+
+    Scope& operator=(const Scope&) = delete;
+
+    /** Restore the category of the enclosing scope. */
+    ~Scope();
+
+  private:
+
+    Category previous;
+  };
+
+}
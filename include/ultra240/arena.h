@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace ultra {
+
+  /**
+   * Arena allocator.
+   *
+   * An arena is a bump allocator over a fixed size block. Allocations are
+   * never freed individually. Instead, the arena is rewound by a scope or
+   * reset entirely, which the renderer does at the start of every frame for
+   * the arena of the main thread, and the worker threads of the library do
+   * after every parallel job for their own arenas.
+   *
+   * Allocations that do not fit in the block are taken from the heap and
+   * released on the next reset, at which point the block grows to the
+   * largest usage seen, overflowed allocations included. Once the block is
+   * large enough, frames perform no heap allocation.
+   */
+  class Arena {
+  public:
+
+    /** Create an arena with a block of the specified size in bytes. */
+    explicit Arena(size_t size);
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    /** Allocate uninitialized memory. */
+    void* allocate(size_t size, size_t alignment);
+
+    /**
+     * Allocate uninitialized memory for `count` objects of type `T`. The
+     * objects are never destroyed, so `T` must be trivially destructible.
+     */
+    template <typename T>
+    T* allocate(size_t count) {
+      static_assert(std::is_trivially_destructible<T>::value);
+      return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    /** Free every allocation. */
+    void reset();
+
+    /** Get the count of bytes allocated from the block. */
+    size_t get_used() const;
+
+    /** Get the size of the block in bytes. */
+    size_t get_size() const;
+
+    /** Get the arena of the calling thread. */
+    static Arena& get();
+
+  private:
+
+    std::unique_ptr<char[]> block;
+
+    size_t size;
+
+    size_t used;
+
+    size_t peak;
+
+    std::vector<std::unique_ptr<char[]>> overflow;
+
+    size_t overflow_used;
+
+    friend class ScopedArena;
+  };
+
+  /**
+   * Scoped arena class.
+   *
+   * Allocations made from the arena while a scoped arena exists are freed
+   * when it is destroyed. Scoped arenas may be nested.
+   */
+  class ScopedArena {
+  public:
+
+    /** Open a scope on the arena of the calling thread. */
+    ScopedArena();
+
+    /** Open a scope on the specified arena. */
+    ScopedArena(Arena& arena);
+
+    ScopedArena(const ScopedArena&) = delete;
+
+    ScopedArena& operator=(const ScopedArena&) = delete;
+
+    /** Free the allocations made within the scope. */
+    ~ScopedArena();
+
+    /** Allocate uninitialized memory for `count` objects of type `T`. */
+    template <typename T>
+    T* allocate(size_t count) {
+      return arena.allocate<T>(count);
+    }
+
+    /** Get the arena of the scope. */
+    Arena& get_arena() const;
+
+  private:
+
+    Arena& arena;
+
+    size_t used;
+
+    size_t overflow_count;
+
+    size_t overflow_used;
+  };
+
+  /**
+   * Standard allocator backed by an arena, for containers of scratch data.
+   * Deallocation is a no-op; memory is reclaimed with the arena.
+   */
+  template <typename T>
+  class ArenaAllocator {
+  public:
+
+    typedef T value_type;
+
+    ArenaAllocator(Arena& arena)
+      : arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& alloc)
+      : arena(alloc.arena) {}
+
+    T* allocate(size_t n) {
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& rhs) const {
+      return arena == rhs.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& rhs) const {
+      return arena != rhs.arena;
+    }
+
+  private:
+
+    Arena* arena;
+
+    template <class U> friend class ArenaAllocator;
+  };
+
+}
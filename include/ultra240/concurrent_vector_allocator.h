@@ -0,0 +1,240 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace ultra {
+
+  /**
+   * Concurrent pool class.
+   *
+   * A concurrent pool is a fixed size backing array of equally sized slots
+   * which can be allocated and freed from any thread without locking. Free
+   * slots are kept on a shared lock-free stack, and each thread keeps a small
+   * cache of free slots so that most allocations and frees touch no shared
+   * state.
+   *
+   * Slots held in the cache of a thread can only be allocated by that thread,
+   * so the capacity should leave room for `cache_size` slots per thread. A
+   * thread returns its cached slots to every pool when it exits.
+   *
+   * Runs of contiguous slots are freed to a list of runs coalesced with their
+   * neighbors, which is guarded by a lock, since only single slots are
+   * expected on hot paths.
+   */
+  class ConcurrentPool {
+  public:
+
+    /** Count of free slots each thread may cache. */
+    static constexpr size_t cache_size = 32;
+
+    /**
+     * Count of threads with a cache at once. Further threads use the stack
+     * only until a thread with a cache exits.
+     */
+    static constexpr size_t max_threads = 64;
+
+    /** Create a pool of `capacity` slots for objects of the specified size. */
+    ConcurrentPool(size_t size, size_t alignment, size_t capacity);
+
+    ConcurrentPool(const ConcurrentPool&) = delete;
+
+    ConcurrentPool& operator=(const ConcurrentPool&) = delete;
+
+    ~ConcurrentPool();
+
+    /** Allocate a slot. Throws std::bad_alloc if the pool is exhausted. */
+    void* allocate();
+
+    /**
+     * Allocate `count` contiguous slots from the first freed run that fits, or
+     * else from the untouched end of the backing array. Throws std::bad_alloc
+     * if there is not enough room.
+     */
+    void* allocate(size_t count);
+
+    /** Free a slot. */
+    void deallocate(void* p);
+
+    /** Free `count` contiguous slots as a run. */
+    void deallocate(void* p, size_t count);
+
+    /** Get the size of each slot in bytes. */
+    size_t get_size() const;
+
+    /** Get the alignment of each slot in bytes. */
+    size_t get_alignment() const;
+
+    /** Get the count of slots. */
+    size_t get_capacity() const;
+
+  private:
+
+    struct alignas(64) Cache {
+      uint32_t count;
+      uint32_t slots[cache_size];
+    };
+
+    struct Run {
+      uint32_t start;
+      uint32_t count;
+    };
+
+    // Cache index of a thread, held until the thread exits.
+    struct Thread;
+
+    Cache* get_cache();
+
+    // Return the cached slots of a thread to the stack.
+    void flush(size_t thread_index);
+
+    void push(uint32_t index);
+
+    bool pop(uint32_t& index);
+
+    // Take slots from the untouched end of the backing array.
+    bool take_untouched(size_t count, uint32_t& index);
+
+    // Take slots from the first freed run that fits.
+    bool take_run(size_t count, uint32_t& index);
+
+    size_t size;
+
+    size_t alignment;
+
+    size_t capacity;
+
+    std::unique_ptr<char[]> block;
+
+    char* base;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> next;
+
+    std::atomic<uint64_t> head;
+
+    std::atomic<size_t> untouched;
+
+    std::unique_ptr<Cache[]> caches;
+
+    std::mutex runs_mutex;
+
+    std::vector<Run> runs;
+  };
+
+  /**
+   * Concurrent pool set class.
+   *
+   * Pools of the same capacity keyed by slot size and alignment, so that
+   * allocators rebound to different types by standard containers still share
+   * backing arrays. Pools are only looked up when an allocator is created.
+   */
+  class ConcurrentPoolSet {
+  public:
+
+    /** Create a set of pools of `capacity` slots each. */
+    ConcurrentPoolSet(size_t capacity);
+
+    /** Get the pool for objects of the specified size and alignment. */
+    ConcurrentPool& get(size_t size, size_t alignment);
+
+    /** Get the count of slots of each pool. */
+    size_t get_capacity() const;
+
+  private:
+
+    size_t capacity;
+
+    std::mutex mutex;
+
+    std::vector<std::unique_ptr<ConcurrentPool>> pools;
+  };
+
+  /**
+   * Concurrent vector allocator.
+   *
+   * A thread-safe counterpart to `VectorAllocator`. Copies of an allocator,
+   * including copies rebound to other types, share their backing arrays, so
+   * several threads can build and prune lists from the same fixed size store
+   * without heap allocation or locking.
+   */
+  template <typename T>
+  class ConcurrentVectorAllocator {
+  public:
+
+    typedef T value_type;
+
+    typedef T* pointer;
+
+    typedef size_t size_type;
+
+    template <class Type> struct rebind {
+      typedef ConcurrentVectorAllocator<Type> other;
+    };
+
+    ConcurrentVectorAllocator() = delete;
+
+    ConcurrentVectorAllocator(size_t size)
+      : pools(std::make_shared<ConcurrentPoolSet>(size)),
+        pool(&pools->get(sizeof(T), alignof(T))) {}
+
+    ConcurrentVectorAllocator(const ConcurrentVectorAllocator& alloc) = default;
+
+    // Moving copies the pools, so that a moved-from allocator is still equal
+    // and usable, as containers expect.
+    ConcurrentVectorAllocator(ConcurrentVectorAllocator&& alloc)
+      : pools(alloc.pools),
+        pool(alloc.pool) {}
+
+    template <class U>
+    ConcurrentVectorAllocator(const ConcurrentVectorAllocator<U>& alloc)
+      : pools(alloc.pools),
+        pool(&pools->get(sizeof(T), alignof(T))) {}
+
+    ConcurrentVectorAllocator& operator=(
+      const ConcurrentVectorAllocator& alloc
+    ) = default;
+
+    pointer allocate(size_type n, void* = nullptr) {
+      if (n == 1) {
+        return static_cast<T*>(pool->allocate());
+      }
+      return static_cast<T*>(pool->allocate(n));
+    }
+
+    void deallocate(pointer p, size_t n) {
+      if (n == 1) {
+        pool->deallocate(p);
+      } else {
+        pool->deallocate(p, n);
+      }
+    }
+
+    template <class U>
+    bool operator==(const ConcurrentVectorAllocator<U>& rhs) const {
+      return pools == rhs.pools;
+    }
+
+    template <class U>
+    bool operator!=(const ConcurrentVectorAllocator<U>& rhs) const {
+      return pools != rhs.pools;
+    }
+
+  private:
+
+    std::shared_ptr<ConcurrentPoolSet> pools;
+
+    ConcurrentPool* pool;
+
+    template <class U> friend class ConcurrentVectorAllocator;
+  };
+
+  template <typename T>
+  using ConcurrentVectorAllocatorList =
+    std::list<T, ConcurrentVectorAllocator<T>>;
+
+}
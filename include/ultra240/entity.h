@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ultra240/allocations.h>
 #include <ultra240/geometry.h>
 #include <ultra240/renderer.h>
 #include <ultra240/tileset.h>
@@ -53,6 +54,7 @@ namespace ultra {
     Tileset::Attributes attributes,
     Args... args
   ) {
+    allocations::Scope scope(allocations::Category::Entities);
     return tileset.library->load_symbol<Entity::Factory<T>::create<
       const Tileset&,
       const renderer::TilesetHandle*,
@@ -75,6 +77,7 @@ namespace ultra {
     const renderer::TilesetHandle* handle,
     Args... args
   ) {
+    allocations::Scope scope(allocations::Category::Entities);
     Tileset::Attributes attributes = {
       .flip_x = entity.attributes.flip_x,
       .flip_y = entity.attributes.flip_y
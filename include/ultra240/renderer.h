@@ -13,7 +13,12 @@ namespace ultra::renderer {
   /** Internal pointer to tileset loaded in graphics hardware. */
   struct TilesetHandle;
 
-  /** Internal pointer to sprites loaded in graphics hardware. */
+  /**
+   * Internal handle to sprites loaded in graphics hardware.
+   *
+   * A handle is not a pointer to an object. Using a handle after it was
+   * unloaded throws an error.
+   */
   struct SpriteHandle;
 
   /** Load a collection of tilesets to the graphics hardware. */
@@ -51,7 +56,12 @@ namespace ultra::renderer {
   /** Unload the world from the graphics hardware. */
   void unload_world();
 
-  /** Set the current world map for rendering. */
+  /**
+   * Set the current world map for rendering.
+   *
+   * The tiles of the map are uploaded to the map tiles texture and the map
+   * tile lookup texture is rebuilt for the tilesets of the map.
+   */
   const TilesetHandle* set_map(uint16_t index);
 
   /** Width of the tileset texture. */
@@ -63,9 +73,57 @@ namespace ultra::renderer {
   /** Number of layers in the tileset texture. */
   inline constexpr uint16_t texture_layers = 64;
 
+  /**
+   * Maximum number of tileset images loaded at once.
+   *
+   * Tileset images are packed together in the layers of the tileset texture,
+   * so that a layer can hold several small images.
+   */
+  inline constexpr uint16_t max_textures = 256;
+
   /** Get the handle to the tilesets texture in hardware. */
   uintptr_t get_texture();
 
+  /**
+   * Get the handle to the tiles texture of the current map in hardware.
+   *
+   * The texture is a `GL_TEXTURE_2D_ARRAY` of `GL_R16UI` texels with one
+   * layer per map layer, holding the tile IDs of `World::Map::tiles`.
+   */
+  uintptr_t get_map_tiles_texture();
+
+  /**
+   * Get the handle to the map tile lookup texture in hardware.
+   *
+   * The texture is a 256x256 `GL_TEXTURE_2D` of `GL_RG16UI` texels indexed
+   * by tile ID. The red channel is the index of the tile in its tileset
+   * image after animation and the green channel is the ID of the tileset
+   * image in the tilesets texture. The entries of animated tiles are updated
+   * for the current frame when this function is called.
+   */
+  uintptr_t get_map_lookup_texture();
+
+  /**
+   * Source of a GLSL vertex shader drawing a map layer as a single quad.
+   *
+   * The shader takes the unit quad vertex as a `vec2` at location 0. The
+   * `projection` and `view` uniforms are the projection and view transforms,
+   * `layer_index` is the map layer, `map_position` is the position of the
+   * map in tiles, and `tiles` is the map tiles texture.
+   */
+  extern const char* const map_layer_vertex_shader;
+
+  /**
+   * Source of a GLSL fragment shader drawing a map layer with
+   * `map_layer_vertex_shader`.
+   *
+   * The `tiles`, `lookup` and `tilesets` samplers are the map tiles, map
+   * tile lookup and tilesets textures, and `texture_rects` are the tileset
+   * image placements. Fragments of empty tiles are discarded. The shader writes
+   * the tileset texel to its `color` output.
+   */
+  extern const char* const map_layer_fragment_shader;
+
   /** 
    * Get the view transform for a map layer.
    *
@@ -104,6 +162,111 @@ namespace ultra::renderer {
     size_t layer_index
   );
 
+  /**
+   * Get matrices for map tile layer vertex and texture transforms on worker
+   * threads.
+   *
+   * The output is the same as that of `get_map_transforms`, including the
+   * zero matrices of empty tiles, but is split in slices written in
+   * parallel by the worker threads of the library and the calling thread.
+   */
+  size_t get_map_transforms_parallel(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    size_t layer_index
+  );
+
+  /**
+   * Get matrices for the visible tiles of a map tile layer.
+   *
+   * Like `get_map_transforms`, but only the non-empty tiles overlapping the
+   * view of the camera are written, using the parallax of the layer as in
+   * `get_view_transform`. The work done is proportional to the size of the
+   * view rather than the size of the map.
+   */
+  size_t get_map_transforms(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    size_t layer_index,
+    const geometry::Vector<float>& camera_position
+  );
+
+  /**
+   * Compact map tile instance.
+   *
+   * An alternative to the map transforms for instanced rendering. Each
+   * instance is expanded to the same vertex and texture coordinates as the
+   * map transforms by `tile_instance_vertex_shader`.
+   */
+  struct TileInstance {
+
+    /** Flip bits. */
+    enum Flags {
+
+      /** Mirrored horizontally. */
+      FlipX = 0x01,
+
+      /** Mirrored vertically. */
+      FlipY = 0x02,
+    };
+
+    /** Horizontal position of the tile in the world, in tiles. */
+    int16_t x;
+
+    /** Vertical position of the tile in the world, in tiles. */
+    int16_t y;
+
+    /** Index of the tile in its tileset image, after animation. */
+    uint16_t tile_index;
+
+    /** ID of the tileset image in the tileset texture. */
+    uint8_t texture_index;
+
+    /** Flip bits of the tile. */
+    uint8_t flags;
+  };
+
+  /**
+   * Source of a GLSL vertex shader expanding tile instances.
+   *
+   * The shader takes the unit quad vertex as a `vec2` at location 0 and the
+   * instance fields as integer attributes, bound with `glVertexAttribIPointer`
+   * and a divisor of 1: `x` and `y` at location 1, `tile_index` at location
+   * 2, and `texture_index` and `flags` at location 3. The `projection` and
+   * `view` uniforms are the projection and view transforms, `layer_index`
+   * is the map layer, and `texture_rects` are the tileset image placements.
+   * The shader writes `gl_Position` and the `texture_coordinate` output to be
+   * sampled from the tileset texture.
+   */
+  extern const char* const tile_instance_vertex_shader;
+
+  /**
+   * Get compact instances for the tiles of a map layer.
+   *
+   * Unlike the map transforms, empty tiles are skipped. The flags of every
+   * instance are zero, as map tile IDs carry no flip bits. This function will
+   * write at most `instances_count` instances and return the count written.
+   */
+  size_t get_map_instances(
+    TileInstance instances[],
+    size_t instances_count,
+    size_t layer_index
+  );
+
+  /**
+   * Get the placement of each tileset image in the tileset texture, for the
+   * `texture_rects` uniform of the tile shaders, to be set with
+   * `glUniform4uiv`.
+   *
+   * The placement of the image with ID `i` is the pair of values at `2 * i`.
+   * The first value packs the position of the image in texels and its layer
+   * as `x | y << 12 | layer << 24`, and the second one packs its size as
+   * `width | height << 16`. Unused IDs have a size of zero.
+   */
+  void get_texture_rects(uint32_t rects[2 * max_textures]);
+
   /** Get the number of sprites contained by the specified handle. */
   size_t get_sprite_count(
     const SpriteHandle* handles[],
@@ -126,6 +289,83 @@ namespace ultra::renderer {
     size_t layer_index
   );
 
+  /**
+   * Get matrices for the sprite vertex and texture transforms on worker
+   * threads.
+   *
+   * The output is the same as that of `get_sprite_transforms`, but is split
+   * in slices written in parallel by the worker threads of the library and
+   * the calling thread.
+   */
+  size_t get_sprite_transforms_parallel(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    const SpriteHandle* handles[],
+    size_t handles_count,
+    size_t layer_index
+  );
+
+  /**
+   * Sprite transforms kept between frames.
+   *
+   * Holds the transforms of the sprites of a collection of sprite handles
+   * on a layer, as written by `update_sprite_transforms`, in the order of
+   * `get_sprite_transforms`.
+   */
+  struct SpriteTransforms {
+
+    /** Vertex transforms of the sprites, 16 floats per sprite. */
+    std::vector<float> vertex_transforms;
+
+    /** Texture transforms of the sprites, 16 floats per sprite. */
+    std::vector<float> tex_transforms;
+
+    /** Index of the first sprite rewritten by the last update. */
+    size_t dirty_begin = 0;
+
+    /**
+     * Index past the last sprite rewritten by the last update. The dirty
+     * range is empty if no sprite was rewritten.
+     */
+    size_t dirty_end = 0;
+
+    /** Source of the transforms of a sprite. */
+    struct Source {
+
+      /** The sprite. */
+      const Sprite* sprite;
+
+      /** Version of the sprite. */
+      uint64_t version;
+
+      /** Internal pointer to the tileset image of the sprite. */
+      const void* texture;
+    };
+
+    /** Sources the transforms were computed from. */
+    std::vector<Source> sources;
+
+    /** Layer the transforms were computed for. */
+    size_t layer_index = 0;
+  };
+
+  /**
+   * Update persistent sprite transforms.
+   *
+   * Only the transforms of sprites that were marked dirty, moved to another
+   * index, or loaded with another tileset image since the last update are
+   * rewritten, and the range of rewritten sprites can be used for a partial
+   * upload. All transforms are rewritten when the layer or the count of
+   * sprites changes. Returns the count of sprites.
+   */
+  size_t update_sprite_transforms(
+    SpriteTransforms& transforms,
+    const SpriteHandle* handles[],
+    size_t handles_count,
+    size_t layer_index
+  );
+
   /** Advance frame counter. */
   void advance();
 
@@ -18,6 +18,14 @@ namespace ultra {
       float transform[9] = nullptr
     );
 
+    /**
+     * Mark the sprite as changed.
+     *
+     * This must be called after modifying the fields of the sprite for the
+     * change to be rendered with `renderer::update_sprite_transforms`.
+     */
+    void mark_dirty();
+
     /** The tileset associated with this sprite. */
     const Tileset& tileset;
 
@@ -36,6 +44,13 @@ namespace ultra {
      * This is initialized to an identity matrix.
      */
     float transform[9];
+
+    /**
+     * Version of the sprite, changed by `mark_dirty`. Versions are drawn from
+     * a counter shared by every sprite, so a sprite constructed at the address
+     * of a destroyed one never has its version.
+     */
+    uint64_t version;
   };
 
 }
@@ -89,6 +89,19 @@ namespace ultra {
       /** Read serialized tile data from stream. */
       void read(std::istream& stream);
 
+      /**
+       * Get the index of the animation tile shown at a frame of the
+       * animation, which repeats every `animation_duration` frames.
+       *
+       * The tile must be animated. The lookup takes constant time for
+       * animations of at most `animation_table_duration` frames, and
+       * logarithmic time in the count of animation tiles otherwise.
+       */
+      uint16_t get_animation_tile_index(uint32_t frame) const;
+
+      /** Maximum duration of animations looked up by frame table. */
+      static constexpr uint32_t animation_table_duration = 256;
+
       /**
        * The tile data name.
        *
@@ -111,6 +124,14 @@ namespace ultra {
 
       /** Code library associated with this tile. */
       std::unique_ptr<DynamicLibrary> library;
+
+    private:
+
+      /** Tile index of each frame of a short animation. */
+      std::vector<uint16_t> animation_frames;
+
+      /** End frame of each animation tile of a long animation. */
+      std::vector<uint32_t> animation_ends;
     };
 
     /** Read a serialized tileset from a file of specified name. */
@@ -123,7 +144,7 @@ namespace ultra {
     uint16_t get_tile_index_by_name(uint32_t name) const;
 
     /** Get number of collision boxes of the specified type. */
-    bool get_collision_boxes_count(
+    size_t get_collision_boxes_count(
       uint16_t tile_index,
       Hash type
     ) const;
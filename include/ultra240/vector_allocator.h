@@ -14,6 +14,12 @@ namespace ultra {
    * contiguous collection. In practice, the list can be appended and pruned
    * after initializing without incurring the runtime performance penalty caused
    * by heap allocation bookkeeping.
+   *
+   * Freed elements are kept on a free list of the same fixed size, so single
+   * element allocations, such as list nodes, are allocated and freed in
+   * constant time. Larger allocations are freed to a list of chunks that are
+   * coalesced with their neighbors, and are taken from the first chunk that
+   * fits before the untouched end of the backing array.
    */
   template <typename T>
   class VectorAllocator {
@@ -37,30 +43,27 @@ namespace ultra {
     VectorAllocator() = delete;
 
     VectorAllocator(size_t size) {
-      vector.reserve(size);
-      chunks.reserve(size);
-      chunks.push_back({&vector[0], size});
+      init(size);
     }
 
     VectorAllocator(const VectorAllocator<T>& alloc) {
-      vector.reserve(alloc.vector.capacity());
-      chunks.reserve(alloc.vector.capacity());
-      chunks.push_back({&vector[0], alloc.vector.capacity()});
+      init(alloc.vector.capacity());
     }
 
     template <class U>
     VectorAllocator(const VectorAllocator<U>& alloc) {
-      vector.reserve(alloc.vector.capacity());
-      chunks.reserve(alloc.vector.capacity());
-      chunks.push_back({&vector[0], alloc.vector.capacity()});
+      init(alloc.vector.capacity());
     }
 
-    pointer allocate(size_type n, void* hint = nullptr) {
+    pointer allocate(size_type n, void* = nullptr) {
+      if (n == 1 && !free.empty()) {
+        T* start = free.back();
+        free.pop_back();
+        return start;
+      }
       auto it = chunks.begin();
       while (it != chunks.end()) {
-        if (it->size >= n
-            && (hint == nullptr
-                || it->start == reinterpret_cast<T*>(hint) + 1)) {
+        if (it->size >= n) {
           T* start = it->start;
           if (it->size > n) {
             it->start += n;
@@ -72,10 +75,32 @@ namespace ultra {
         }
         it++;
       }
+      if (static_cast<size_t>(end - next) >= n) {
+        T* start = next;
+        next += n;
+        return start;
+      }
       throw std::bad_alloc();
     }
 
     void deallocate(pointer p, size_t n) {
+      if (p + n == next) {
+        // Return the most recent allocation to the untouched end, along with
+        // a chunk freed just before it.
+        next = p;
+        for (auto it = chunks.begin(); it != chunks.end(); it++) {
+          if (it->start + it->size == next) {
+            next = it->start;
+            chunks.erase(it);
+            break;
+          }
+        }
+        return;
+      }
+      if (n == 1) {
+        free.push_back(p);
+        return;
+      }
       auto before = chunks.end();
       auto after = chunks.end();
       auto it = chunks.begin();
@@ -104,10 +129,25 @@ namespace ultra {
 
   private:
 
+    void init(size_t size) {
+      vector.reserve(size);
+      free.reserve(size);
+      // Chunks are never adjacent, so at most every other element starts one.
+      chunks.reserve(size / 2 + 1);
+      next = vector.data();
+      end = next + size;
+    }
+
     std::vector<T> vector;
 
+    std::vector<T*> free;
+
     std::vector<Chunk> chunks;
 
+    T* next;
+
+    T* end;
+
     template <class U> friend class VectorAllocator;
   };
 
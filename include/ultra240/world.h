@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 #include <ultra240/hash.h>
 #include <ultra240/geometry.h>
 #include <ultra240/tileset.h>
@@ -147,8 +148,31 @@ namespace ultra {
          * entity animations.
          */
         OneWay = 0x40,
+
+        /**
+         * Collision layers mask.
+         *
+         * The lower bits of the serialized boundary flags assign the boundary
+         * to one or more collision layers. A boundary without any layer bits
+         * set is assigned to the default layer.
+         */
+        Layers = 0x3f,
+
+        /**
+         * Dynamic boundary flag.
+         *
+         * Set on boundaries registered at runtime with
+         * `World::add_dynamic_boundaries`. This flag is never serialized.
+         */
+        Dynamic = 0x80,
       };
 
+      /** The layer boundaries are assigned to when none is specified. */
+      static constexpr uint8_t default_layers = 0x01;
+
+      /** Layer mask matching boundaries on all layers. */
+      static constexpr uint8_t all_layers = 0xff;
+
       /** Instance constructor. */
       Boundary();
 
@@ -165,8 +189,19 @@ namespace ultra {
         const geometry::Vector<float>& q
       );
 
+      /** Construct boundary from two vectors, flags, and collision layers. */
+      Boundary(
+        uint8_t flags,
+        uint8_t layers,
+        const geometry::Vector<float>& p,
+        const geometry::Vector<float>& q
+      );
+
       /** Boundary flags. */
       uint8_t flags;
+
+      /** Mask of the collision layers the boundary is assigned to. */
+      uint8_t layers;
     };
 
     /** General structure describing a collision. */
@@ -187,32 +222,476 @@ namespace ultra {
       geometry::Vector<float> distance;
     };
 
-    /** Fixed size vector backed list of boundaries. */
-    using Boundaries = VectorAllocatorList<Boundary>;
+    /**
+     * Boundaries class.
+     *
+     * A fixed capacity array of boundaries paired with a contiguous array of
+     * quantized copies of the boundaries. Collision queries stream through
+     * the quantized copies and only convert the boundaries near the collision
+     * boxes to full precision.
+     *
+     * The index of a boundary never changes while it is in the collection.
+     * Erasing boundaries before the end of the collection leaves tombstones,
+     * which belong to no layer and are skipped by the collision functions,
+     * until the slots are reused by a later insertion.
+     */
+    class Boundaries {
+    public:
+
+      /** Boundary iterator. */
+      using const_iterator = std::vector<Boundary>::const_iterator;
+
+      /**
+       * Quantized boundary.
+       *
+       * Endpoints are rounded to whole pixels relative to the origin of the
+       * collection, which is the first endpoint of its first boundary, and
+       * saturated to the 16-bit range.
+       */
+      struct Quantized {
+        int16_t px;
+        int16_t py;
+        int16_t qx;
+        int16_t qy;
+        uint8_t flags;
+        uint8_t layers;
+      };
+
+      /** Create an empty collection with room for `capacity` boundaries. */
+      explicit Boundaries(size_t capacity);
+
+      /** Get an iterator to the first boundary. */
+      const_iterator begin() const;
+
+      /** Get an iterator past the last boundary. */
+      const_iterator end() const;
+
+      /** Get an iterator to the first boundary. */
+      const_iterator cbegin() const;
+
+      /** Get an iterator past the last boundary. */
+      const_iterator cend() const;
+
+      /** Get the count of boundaries, including tombstones. */
+      size_t size() const;
+
+      /** Return true if the collection is empty. */
+      bool empty() const;
+
+      /** Get the boundary at the specified index. */
+      const Boundary& operator[](size_t index) const;
+
+      /**
+       * Append a boundary. Throws std::bad_alloc if the collection is at
+       * capacity.
+       */
+      void push_back(const Boundary& boundary);
+
+      /** Construct a boundary in place at the end of the collection. */
+      template <typename... Args>
+      void emplace_back(Args&&... args) {
+        push_back(Boundary(std::forward<Args>(args)...));
+      }
+
+      /**
+       * Insert `count` consecutive boundaries and return the index of the
+       * first. The boundaries are appended if there is room, otherwise they
+       * take the first run of tombstones long enough to hold them. Throws
+       * std::bad_alloc if neither exists.
+       */
+      size_t insert(const Boundary boundaries[], size_t count);
+
+      /** Replace the endpoints of the boundary at the specified index. */
+      void set(
+        size_t index,
+        const geometry::Vector<float>& p,
+        const geometry::Vector<float>& q
+      );
+
+      /**
+       * Erase `count` boundaries starting at the specified index. The indices
+       * of the remaining boundaries are unchanged.
+       */
+      void erase(size_t index, size_t count);
+
+      /** Get the quantized boundaries in collection order. */
+      const Quantized* get_quantized() const;
+
+      /** Get the origin of the quantized boundaries. */
+      const geometry::Vector<float>& get_origin() const;
+
+      /**
+       * Get the version of the collection. The version changes whenever a
+       * boundary is added, moved, or erased.
+       */
+      uint32_t get_version() const;
+
+      /**
+       * Return true if no boundary within the specified bounds was added,
+       * moved, or erased since the collection had the specified version. Only
+       * the most recent changes are remembered, so older versions are always
+       * considered changed.
+       */
+      bool is_unchanged(
+        uint32_t version,
+        const geometry::Vector<float>& min,
+        const geometry::Vector<float>& max
+      ) const;
+
+    private:
+
+      // Quantized bounds of the boundaries affected by a change.
+      struct Change {
+        uint32_t version;
+        int16_t left;
+        int16_t top;
+        int16_t right;
+        int16_t bottom;
+      };
+
+      static constexpr size_t changes_count = 256;
+
+      void assign(size_t index, const Boundary& boundary);
+
+      void add_change(const Quantized quantized[], size_t count);
+
+      void add_change(const Quantized& before, const Quantized& after);
+
+      Quantized quantize(const Boundary& boundary) const;
+
+      std::vector<Boundary> boundaries;
+
+      std::vector<Quantized> quantized;
+
+      std::vector<bool> erased;
+
+      geometry::Vector<float> origin;
+
+      uint32_t version;
+
+      // Ring of the most recent changes, indexed by version.
+      Change changes[changes_count];
+    };
 
     /** Structure describing an entity collision with a boundary. */
     struct BoundaryCollision : Collision {
 
-      /** Iterator pointing to the boundary the entity collided with. */
-      typename Boundaries::const_iterator boundary;
+      /** Index of the boundary the entity collided with. */
+      size_t index;
+
+      /** The boundary the entity collided with. */
+      const Boundary* boundary;
+    };
+
+    /**
+     * Collision query statistics.
+     *
+     * Statistics are only counted when the library is configured with
+     * `--enable-collision-stats`, otherwise every count is zero.
+     */
+    struct CollisionStats {
+
+      /** Count of collision queries. */
+      uint32_t queries;
+
+      /** Count of boundaries visited by boundary loops. */
+      uint32_t boundaries_visited;
+
+      /** Count of line intersection tests. */
+      uint32_t intersection_tests;
+
+      /** Count of boundaries rejected by their direction. */
+      uint32_t direction_rejects;
+
+      /** Count of position adjustments restarting a fit. */
+      uint32_t adjust_restarts;
+
+      /** Count of fits that failed because the collision boxes were stuck. */
+      uint32_t stuck_detections;
+    };
+
+    /**
+     * Get the collision statistics accumulated since the start of the current
+     * frame.
+     *
+     * The difference of two results can be used to attribute statistics to
+     * the queries made in between.
+     */
+    static CollisionStats get_collision_stats();
+
+    /** Get the collision statistics of the previous frame. */
+    static CollisionStats get_frame_collision_stats();
+
+    /**
+     * Fit cache class.
+     *
+     * A fit cache memoizes the purely geometric part of fitting the collision
+     * boxes of a tile in place of the collision boxes of another tile: the
+     * collision boxes of both tiles and the transits between their corners,
+     * relative to the entity position. Entries are keyed by tileset, collision
+     * box type, tile indices, and attributes.
+     */
+    class FitCache {
+    public:
+
+      /** Transit of a previous collision box corner to a new position. */
+      struct Transit {
+
+        /** Line segment from the previous corner to the next corner. */
+        geometry::LineSegment<float> segment;
+
+        /** Slope of the line segment. */
+        float slope;
+
+        /** False if the corner does not move. */
+        bool is_line;
+      };
+
+      /** Cached collision boxes and transits for a pair of tiles. */
+      struct Entry {
+
+        /** Collision boxes of the previous tile. */
+        std::vector<Tileset::Tile::CollisionBox<float>> prev_collision_boxes;
+
+        /** Collision boxes of the next tile. */
+        std::vector<Tileset::Tile::CollisionBox<float>> next_collision_boxes;
+
+        /**
+         * Transits of each previous collision box corner to the corresponding
+         * corner of each next collision box, indexed by next collision box,
+         * previous collision box, and corner.
+         */
+        std::vector<Transit> transits;
+      };
+
+      /**
+       * Get the entry for a pair of tiles, computing it if it is not already
+       * cached.
+       */
+      const Entry& get(
+        const Tileset& tileset,
+        Hash type,
+        uint16_t prev_tile_index,
+        Tileset::Attributes prev_attributes,
+        uint16_t next_tile_index,
+        Tileset::Attributes next_attributes
+      );
+
+      /** Remove all cached entries. */
+      void clear();
+
+    private:
+
+      struct Key {
+        const Tileset* tileset;
+        Hash type;
+        uint16_t prev_tile_index;
+        uint16_t next_tile_index;
+        uint8_t attributes;
+        bool operator==(const Key& rhs) const;
+      };
+
+      struct KeyHash {
+        size_t operator()(const Key& key) const;
+      };
+
+      std::unordered_map<Key, Entry, KeyHash> entries;
+    };
+
+    /**
+     * Distance field class.
+     *
+     * A distance field is a sparse grid of the distances from its vertices to
+     * the nearest static boundary, clamped to a maximum distance. Only the
+     * blocks of the grid within the maximum distance of a boundary are stored.
+     * Boundaries are open line segments without an inside, so distances are
+     * unsigned.
+     *
+     * Dynamic boundaries are not baked into the field. They must follow every
+     * static boundary in the boundaries collection, as they do in a world.
+     */
+    class DistanceField {
+    public:
+
+      /** Bake a distance field from the static boundaries of a collection. */
+      DistanceField(
+        const Boundaries& boundaries,
+        float cell_size = 8,
+        float max_distance = 64
+      );
+
+      /**
+       * Get the approximate distance from a point to the nearest static
+       * boundary, interpolated from the surrounding grid vertices. Distances
+       * greater than the maximum distance are clamped.
+       */
+      float distance_to_boundary(const geometry::Vector<float>& point) const;
+
+      /**
+       * Get the gradient of the distance at a point. The gradient points away
+       * from the nearest static boundary and is zero in free space beyond the
+       * maximum distance.
+       */
+      geometry::Vector<float> distance_gradient(
+        const geometry::Vector<float>& point
+      ) const;
+
+      /**
+       * Get a lower bound of the distance from a point to the nearest static
+       * boundary. Unlike `distance_to_boundary`, the result never exceeds the
+       * exact distance.
+       */
+      float clearance(const geometry::Vector<float>& point) const;
+
+      /** Get the maximum distance of the field. */
+      float get_max_distance() const;
+
+    private:
+
+      float get_vertex(int32_t x, int32_t y) const;
+
+      float& get_vertex_ref(int32_t x, int32_t y);
+
+      float cell_size;
+
+      float max_distance;
+
+      std::unordered_map<uint64_t, std::vector<float>> blocks;
+
+      size_t static_count;
+
+      friend class World;
+    };
+
+    /**
+     * Resting contact class.
+     *
+     * A resting contact remembers the last boundary collision query of an
+     * entity. While the collision boxes, force, collision layers, and the
+     * boundaries within reach of the boxes are unchanged, the query sleeps and
+     * the remembered result is returned without scanning the boundaries. Any
+     * such change wakes it, while changes to boundaries out of reach, such as
+     * a platform moving elsewhere, do not.
+     */
+    class RestingContact {
+    public:
+
+      /** Create an awake resting contact. */
+      RestingContact();
+
+      /**
+       * Find a collision between collision boxes and a boundary, returning the
+       * remembered result if the query is unchanged.
+       */
+      std::pair<bool, BoundaryCollision> get_boundary_collision(
+        geometry::Vector<float> force,
+        const Tileset::Tile::CollisionBox<float> collision_boxes[],
+        size_t collision_boxes_count,
+        const Boundaries& boundaries,
+        uint8_t layers = Boundary::all_layers
+      );
+
+      /** Return true if the last query returned the remembered result. */
+      bool is_sleeping() const;
+
+      /** Forget the remembered result so that the next query scans. */
+      void wake();
+
+    private:
+
+      bool is_unchanged(
+        const geometry::Vector<float>& force,
+        const Tileset::Tile::CollisionBox<float> collision_boxes[],
+        size_t collision_boxes_count,
+        const Boundaries& boundaries,
+        uint8_t layers
+      ) const;
+
+      std::vector<Tileset::Tile::CollisionBox<float>> collision_boxes;
+
+      geometry::Vector<float> force;
+
+      const Boundaries* boundaries;
+
+      uint32_t version;
+
+      uint8_t layers;
+
+      bool sleeping;
+
+      std::pair<bool, BoundaryCollision> result;
     };
 
     /**
      * Find a collision between collision boxes and a boundary, if any. If
      * there are no collisions, the first element of the returned pair is false,
      * and the collision data contains no information.
+     *
+     * Only boundaries assigned to at least one of the specified collision
+     * layers are checked.
      */
     static std::pair<bool, BoundaryCollision> get_boundary_collision(
       geometry::Vector<float> force,
       const Tileset::Tile::CollisionBox<float> collision_boxes[],
       size_t collision_boxes_count,
-      const Boundaries& boundaries
+      const Boundaries& boundaries,
+      uint8_t layers = Boundary::all_layers
+    );
+
+    /**
+     * Find a collision between collision boxes and a boundary, if any, using a
+     * distance field baked from the boundaries to skip the static boundaries
+     * for collision boxes that cannot reach them with the specified force.
+     */
+    static std::pair<bool, BoundaryCollision> get_boundary_collision(
+      geometry::Vector<float> force,
+      const Tileset::Tile::CollisionBox<float> collision_boxes[],
+      size_t collision_boxes_count,
+      const Boundaries& boundaries,
+      const DistanceField& distance_field,
+      uint8_t layers = Boundary::all_layers
+    );
+
+    /**
+     * Find all collisions between collision boxes and boundaries in a single
+     * pass. At most `collisions_count` collisions are written, sorted by
+     * ascending distance, with only the closest collision kept for each pair of
+     * collision box name and boundary. The first collision written is the one
+     * returned by `get_boundary_collision`. Returns the count of collisions
+     * written.
+     */
+    static size_t get_boundary_collisions(
+      BoundaryCollision collisions[],
+      size_t collisions_count,
+      geometry::Vector<float> force,
+      const Tileset::Tile::CollisionBox<float> collision_boxes[],
+      size_t collision_boxes_count,
+      const Boundaries& boundaries,
+      uint8_t layers = Boundary::all_layers
+    );
+
+    /**
+     * Find all collisions between collision boxes and boundaries in a single
+     * pass, using a distance field baked from the boundaries to skip the
+     * static boundaries for collision boxes that cannot reach them.
+     */
+    static size_t get_boundary_collisions(
+      BoundaryCollision collisions[],
+      size_t collisions_count,
+      geometry::Vector<float> force,
+      const Tileset::Tile::CollisionBox<float> collision_boxes[],
+      size_t collision_boxes_count,
+      const Boundaries& boundaries,
+      const DistanceField& distance_field,
+      uint8_t layers = Boundary::all_layers
     );
 
     /**
      * Determines if a new collection of collision boxes can fit in within the
      * specified boundries. If so, the first element of the returned pair is
      * true and the second is the position offset required to make the fit.
+     * Only boundaries assigned to at least one of the specified collision
+     * layers are checked.
      */
     static std::pair<bool, geometry::Vector<float>> can_fit_collision_boxes(
       const Tileset::Tile::CollisionBox<float> prev_collision_boxes[],
@@ -220,21 +699,171 @@ namespace ultra {
       const Tileset::Tile::CollisionBox<float> next_collision_boxes[],
       size_t next_collision_boxes_count,
       const Boundaries& boundaries,
-      bool check_transits
+      bool check_transits,
+      uint8_t layers = Boundary::all_layers
+    );
+
+    /**
+     * Determines if the next collision boxes of a fit cache entry can fit in
+     * place of its previous collision boxes, with both sets positioned at the
+     * specified position. The collision boxes and transit geometry are taken
+     * from the entry, leaving only the boundary tests to be performed.
+     */
+    static std::pair<bool, geometry::Vector<float>> can_fit_collision_boxes(
+      const FitCache::Entry& entry,
+      const geometry::Vector<float>& position,
+      const Boundaries& boundaries,
+      bool check_transits,
+      uint8_t layers = Boundary::all_layers
+    );
+
+    /** A candidate collection of collision boxes for `find_first_fit`. */
+    struct FitCandidate {
+
+      /** The collision boxes of the candidate. */
+      const Tileset::Tile::CollisionBox<float>* collision_boxes;
+
+      /** Count of collision boxes of the candidate. */
+      size_t collision_boxes_count;
+    };
+
+    /**
+     * Find the first of several candidate collections of collision boxes that
+     * can fit in place of the previous collision boxes, such as the crouching,
+     * sliding, and standing tiles of an entity. Returns the index of the
+     * first candidate that fits and its position offset, or the count of
+     * candidates if none fits.
+     *
+     * The boundaries near the collision boxes are gathered once and shared by
+     * every candidate. If `parallel` is true, the candidates are evaluated
+     * concurrently on the worker threads of the library.
+     */
+    static std::pair<size_t, geometry::Vector<float>> find_first_fit(
+      const Tileset::Tile::CollisionBox<float> prev_collision_boxes[],
+      size_t prev_collision_boxes_count,
+      const FitCandidate candidates[],
+      size_t candidates_count,
+      const Boundaries& boundaries,
+      bool check_transits,
+      uint8_t layers = Boundary::all_layers,
+      bool parallel = false
     );
 
-    /** Load serialized world from specified file name. */
-    World(const std::string& name);
+    /**
+     * A set of dynamic boundaries.
+     *
+     * Dynamic boundaries are line segments added to the boundaries collection
+     * at runtime whose position can change every frame.
+     */
+    struct DynamicBoundaries {
+
+      /** Index of the first line segment of the set. */
+      size_t index;
+
+      /** The points comprising the set relative to its position. */
+      std::vector<geometry::Vector<float>> points;
+
+      /** Position of the set. */
+      geometry::Vector<float> position;
+    };
+
+    /**
+     * Load serialized world from specified file name.
+     *
+     * Room for `dynamic_boundaries_count` dynamic boundary line segments is
+     * reserved in the boundaries collection, which never grows, so that the
+     * segments of dynamic boundaries can be added without reallocating it.
+     * Adding a set of dynamic boundaries still allocates its handle and a
+     * copy of its points.
+     */
+    World(const std::string& name, size_t dynamic_boundaries_count = 0);
 
     /** Get the boundaries collection. */
     const Boundaries& get_boundaries() const;
 
+    /**
+     * Bake a distance field from the static boundaries of the world, replacing
+     * any previously baked distance field.
+     */
+    void bake_distance_field(float cell_size = 8, float max_distance = 64);
+
+    /**
+     * Get the distance field of the world, or nullptr if no distance field was
+     * baked.
+     */
+    const DistanceField* get_distance_field() const;
+
+    /**
+     * Add a set of dynamic boundaries, such as those of a moving platform.
+     *
+     * Each point is connected to the next point in the list, like serialized
+     * boundaries. The points are relative to the specified position and the
+     * resulting line segments are inserted into the boundaries collection,
+     * so they are checked by the collision functions alongside the static
+     * boundaries. Segments are appended when there is room, otherwise they
+     * reuse the slots of removed sets.
+     */
+    const DynamicBoundaries* add_dynamic_boundaries(
+      const geometry::Vector<float> points[],
+      size_t points_count,
+      const geometry::Vector<float>& position = {0, 0},
+      uint8_t flags = 0,
+      uint8_t layers = Boundary::default_layers
+    );
+
+    /**
+     * Move a set of dynamic boundaries to the specified position.
+     *
+     * Only the line segments of the set are updated.
+     */
+    void set_dynamic_boundaries_position(
+      const DynamicBoundaries* handle,
+      const geometry::Vector<float>& position
+    );
+
+    /** Get the current position of a set of dynamic boundaries. */
+    const geometry::Vector<float>& get_dynamic_boundaries_position(
+      const DynamicBoundaries* handle
+    ) const;
+
+    /** Remove a set of dynamic boundaries from the boundaries collection. */
+    void remove_dynamic_boundaries(const DynamicBoundaries* handle);
+
     /** Collection of world maps. */
     std::vector<Map> maps;
 
   private:
 
+    static std::pair<bool, BoundaryCollision> get_boundary_collision(
+      geometry::Vector<float> force,
+      const Tileset::Tile::CollisionBox<float> collision_boxes[],
+      size_t collision_boxes_count,
+      const Boundaries& boundaries,
+      const DistanceField* distance_field,
+      size_t static_count,
+      uint8_t layers
+    );
+
+    static size_t get_boundary_collisions(
+      BoundaryCollision collisions[],
+      size_t collisions_count,
+      geometry::Vector<float> force,
+      const Tileset::Tile::CollisionBox<float> collision_boxes[],
+      size_t collision_boxes_count,
+      const Boundaries& boundaries,
+      const DistanceField* distance_field,
+      size_t static_count,
+      uint8_t layers
+    );
+
     std::unique_ptr<Boundaries> boundaries;
+
+    std::unique_ptr<DistanceField> distance_field;
+
+    std::unordered_map<
+      const DynamicBoundaries*,
+      std::unique_ptr<DynamicBoundaries>
+    > dynamic_boundaries;
   };
 
 }
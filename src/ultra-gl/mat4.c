@@ -16,19 +16,6 @@ static void mat4_identity(
   memcpy(r, identity, sizeof(identity));
 }
 
-static void mat4_from_mat3(
-  mat4 r,
-  const GLfloat mat3[9]
-) {
-  mat4 transform = {
-    mat3[0], mat3[1], mat3[2], 0,
-    mat3[3], mat3[4], mat3[5], 0,
-    mat3[6], mat3[7], mat3[8], 0,
-    0, 0, 0, 1,
-  };
-  memcpy(r, transform, sizeof(transform));
-}
-
 static void mat4_translate(
   mat4 r,
   GLfloat x,
@@ -59,6 +46,66 @@ static void mat4_scale(
   memcpy(r, scale, sizeof(scale));
 }
 
+/* Scale followed by a translation. */
+static void mat4_scale_translate(
+  mat4 r,
+  GLfloat sx,
+  GLfloat sy,
+  GLfloat sz,
+  GLfloat tx,
+  GLfloat ty,
+  GLfloat tz
+) {
+  mat4 transform = {
+    sx, 0, 0, 0,
+    0, sy, 0, 0,
+    0, 0, sz, 0,
+    tx, ty, tz, 1,
+  };
+  memcpy(r, transform, sizeof(transform));
+}
+
+/* Scale followed by a 3x3 matrix and a translation. */
+static void mat4_scale_mat3_translate(
+  mat4 r,
+  GLfloat sx,
+  GLfloat sy,
+  GLfloat sz,
+  const GLfloat mat3[9],
+  GLfloat tx,
+  GLfloat ty,
+  GLfloat tz
+) {
+  mat4 transform = {
+    sx * mat3[0], sx * mat3[1], sx * mat3[2], 0,
+    sy * mat3[3], sy * mat3[4], sy * mat3[5], 0,
+    sz * mat3[6], sz * mat3[7], sz * mat3[8], 0,
+    tx, ty, tz, 1,
+  };
+  memcpy(r, transform, sizeof(transform));
+}
+
+/*
+ * Flip the unit square about its center before a transform, in place. This
+ * is the product of the flip and the transform.
+ */
+static void mat4_flip_unit(
+  mat4 r,
+  bool x,
+  bool y
+) {
+  for (int i = 0; i < 4; i++) {
+    if (x) {
+      r[12 + i] += r[i];
+      r[i] = -r[i];
+    }
+    if (y) {
+      r[12 + i] += r[4 + i];
+      r[4 + i] = -r[4 + i];
+    }
+  }
+}
+
 static void mat4_mult_mat4(
   mat4 r,
   const mat4 a,
@@ -1,12 +1,17 @@
 #define GL_GLEXT_PROTOTYPES
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <GL/gl.h>
 #include <GL/glext.h>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <queue>
 #include <set>
+#include <string_view>
 #include <unordered_map>
+#include <ultra240/arena.h>
 #include <ultra240/renderer.h>
 #include "ultra/ultra.h"
 #include "mat4.c"
@@ -43,8 +48,159 @@ static const char* glEnumName(GLenum _enum) {
 
 namespace ultra::renderer {
 
+  static_assert(sizeof(TileInstance) == 8);
+
+  // The texture coordinates computed by the tile instance shader assume the
+  // size of the tileset texture.
+  static_assert(texture_width == 2048 && texture_height == 2048);
+
+  // The placements of get_texture_rects are packed two per uniform vector.
+  static_assert(max_textures == 256);
+
+  // GLSL declarations unpacking the placements of the tileset images.
+#define TEXTURE_RECT_SOURCE                                           \
+  "uniform uvec4 texture_rects[128];\n"                               \
+  "\n"                                                                \
+  "struct TextureRect {\n"                                            \
+  "  uvec2 position;\n"                                               \
+  "  uvec2 size;\n"                                                   \
+  "  uint layer;\n"                                                   \
+  "};\n"                                                              \
+  "\n"                                                                \
+  "TextureRect get_texture_rect(uint texture_index) {\n"              \
+  "  uvec4 pair = texture_rects[texture_index / 2u];\n"               \
+  "  uvec2 rect = (texture_index % 2u) == 0u ? pair.xy : pair.zw;\n"  \
+  "  return TextureRect(\n"                                           \
+  "    uvec2(rect.x & 0xfffu, (rect.x >> 12) & 0xfffu),\n"            \
+  "    uvec2(rect.y & 0xffffu, rect.y >> 16),\n"                      \
+  "    rect.x >> 24\n"                                                \
+  "  );\n"                                                            \
+  "}\n"
+
+  const char* const tile_instance_vertex_shader = R"(#version 330 core
+
+layout(location = 0) in vec2 vertex;
+layout(location = 1) in ivec2 position;
+layout(location = 2) in uint tile_index;
+layout(location = 3) in uvec2 texture_index_flags;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform uint layer_index;
+)" TEXTURE_RECT_SOURCE R"(
+out vec3 texture_coordinate;
+
+void main() {
+  float layer_z = (15.0 - float(layer_index)) / 16.0;
+  gl_Position = projection * view * vec4(
+    16.0 * (vec2(position) + vertex),
+    layer_z,
+    1.0
+  );
+  uint texture_index = texture_index_flags.x;
+  uint flags = texture_index_flags.y;
+  vec2 corner = vertex;
+  if ((flags & 1u) != 0u) {
+    corner.x = 1.0 - corner.x;
+  }
+  if ((flags & 2u) != 0u) {
+    corner.y = 1.0 - corner.y;
+  }
+  // Tiles are laid out in rows from the top of the tileset image, which is
+  // stored upside down in the texture.
+  TextureRect rect = get_texture_rect(texture_index);
+  uint offset = 16u * tile_index;
+  vec2 origin = vec2(rect.position) + vec2(
+    float(offset % rect.size.x),
+    float(rect.size.y) - float(offset / rect.size.x * 16u) - 16.0
+  );
+  texture_coordinate = vec3(
+    (origin + 16.0 * vec2(corner.x, 1.0 - corner.y)) / 2048.0,
+    float(rect.layer)
+  );
+}
+)";
+
+  const char* const map_layer_vertex_shader = R"(#version 330 core
+
+layout(location = 0) in vec2 vertex;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform ivec2 map_position;
+uniform uint layer_index;
+uniform usampler2DArray tiles;
+
+out vec2 map_coordinate;
+
+void main() {
+  float layer_z = (15.0 - float(layer_index)) / 16.0;
+  map_coordinate = vertex * vec2(textureSize(tiles, 0).xy);
+  gl_Position = projection * view * vec4(
+    16.0 * (vec2(map_position) + map_coordinate),
+    layer_z,
+    1.0
+  );
+}
+)";
+
+  const char* const map_layer_fragment_shader = R"(#version 330 core
+
+in vec2 map_coordinate;
+
+uniform uint layer_index;
+uniform usampler2DArray tiles;
+uniform usampler2D lookup;
+uniform sampler2DArray tilesets;
+)" TEXTURE_RECT_SOURCE R"(
+out vec4 color;
+
+void main() {
+  ivec2 map_size = textureSize(tiles, 0).xy;
+  ivec2 cell = clamp(ivec2(floor(map_coordinate)), ivec2(0), map_size - 1);
+  uint tile = texelFetch(tiles, ivec3(cell, int(layer_index)), 0).r;
+  if (tile == 0u) {
+    discard;
+  }
+  uvec2 entry = texelFetch(
+    lookup,
+    ivec2(int(tile % 256u), int(tile / 256u)),
+    0
+  ).rg;
+  // Tiles are laid out in rows from the top of the tileset image, which is
+  // stored upside down in the texture.
+  TextureRect rect = get_texture_rect(entry.y);
+  uint offset = 16u * entry.x;
+  ivec2 pixel = ivec2(floor(fract(map_coordinate) * 16.0));
+  ivec2 texel = ivec2(rect.position) + ivec2(
+    int(offset % rect.size.x) + pixel.x,
+    int(rect.size.y) - int(offset / rect.size.x * 16u) - 1 - pixel.y
+  );
+  color = texelFetch(tilesets, ivec3(texel, int(rect.layer)), 0);
+}
+)";
+
+#undef TEXTURE_RECT_SOURCE
+
+  // Minimum counts of map tiles and sprites handled by a worker thread.
+  static const size_t map_transforms_grain = 4096;
+
+  static const size_t sprite_transforms_grain = 256;
+
+  // Size of the view covered by the projection transform, in pixels.
+  static const float view_width = 256;
+
+  static const float view_height = 240;
+
+  // The map tile lookup texture has one entry for every tile ID.
+  static const GLsizei map_lookup_width = 256;
+
+  static const GLsizei map_lookup_height = 256;
+
   enum {
     TEXTURE_IDX_TILESETS,
+    TEXTURE_IDX_MAP_TILES,
+    TEXTURE_IDX_MAP_LOOKUP,
     TEXTURE_COUNT,
   };
 
@@ -56,6 +212,99 @@ namespace ultra::renderer {
     } type;
     geometry::Vector<uint32_t> size;
     GLubyte index;
+    GLubyte layer;
+    geometry::Vector<uint32_t> position;
+  };
+
+  // Packs tileset images in a layer of the tileset texture. The skyline is
+  // the top edge of the packed images, as segments from left to right. The
+  // space of removed images is reclaimed once the layer is empty.
+  class TextureLayer {
+  public:
+
+    TextureLayer() {
+      clear();
+    }
+
+    bool add(
+      const geometry::Vector<uint32_t>& size,
+      geometry::Vector<uint32_t>& position
+    ) {
+      // Place the image at the lowest position where it fits, leftmost
+      // first.
+      size_t best = segments.size();
+      uint32_t best_y = texture_height;
+      for (size_t i = 0; i < segments.size(); i++) {
+        auto left = segments[i].x;
+        if (left + size.x > texture_width) {
+          break;
+        }
+        uint32_t y = 0;
+        for (size_t j = i;
+             j < segments.size() && segments[j].x < left + size.x;
+             j++) {
+          y = std::max(y, segments[j].y);
+        }
+        if (y + size.y <= texture_height && y < best_y) {
+          best = i;
+          best_y = y;
+        }
+      }
+      if (best == segments.size()) {
+        return false;
+      }
+      position = {segments[best].x, best_y};
+      // Replace the segments under the image by its top edge.
+      auto right = position.x + size.x;
+      auto end = best;
+      while (end < segments.size()
+             && segments[end].x + segments[end].width <= right) {
+        end++;
+      }
+      if (end < segments.size() && segments[end].x < right) {
+        segments[end].width -= right - segments[end].x;
+        segments[end].x = right;
+      }
+      segments.erase(segments.begin() + best, segments.begin() + end);
+      segments.insert(
+        segments.begin() + best,
+        {.x = position.x, .y = best_y + size.y, .width = size.x}
+      );
+      // Merge neighbouring segments of the same height.
+      for (size_t i = 1; i < segments.size();) {
+        if (segments[i].y == segments[i - 1].y) {
+          segments[i - 1].width += segments[i].width;
+          segments.erase(segments.begin() + i);
+        } else {
+          i++;
+        }
+      }
+      images_count++;
+      return true;
+    }
+
+    void remove() {
+      if (!--images_count) {
+        clear();
+      }
+    }
+
+  private:
+
+    void clear() {
+      segments = {{.x = 0, .y = 0, .width = texture_width}};
+      images_count = 0;
+    }
+
+    struct Segment {
+      uint32_t x;
+      uint32_t y;
+      uint32_t width;
+    };
+
+    std::vector<Segment> segments;
+
+    size_t images_count;
   };
 
   using TextureList = std::list<Texture>;
@@ -71,11 +320,37 @@ namespace ultra::renderer {
     std::unordered_map<std::string, const Texture*> texture_map;
   };
 
-  struct SpriteHandle {
-    std::list<SpriteTexture>::iterator begin;
-    size_t count;
+  // The sprites of a sprite handle, stored contiguously.
+  struct SpriteBlock {
+    std::vector<SpriteTexture> sprites;
+    uint32_t slot;
   };
 
+  // The slot of a sprite handle locates its block. The generation changes
+  // whenever the slot is freed.
+  struct SpriteSlot {
+    uint32_t block;
+    uintptr_t generation;
+  };
+
+  // Sprite handles are not pointers to objects but tokens packing the index
+  // of their slot in the lower half and its generation in the upper half,
+  // so that a handle used after being unloaded is detected even once its
+  // slot is reused.
+  static const int sprite_slot_bits = 4 * sizeof(uintptr_t);
+
+  static const uintptr_t sprite_slot_mask =
+    (uintptr_t(1) << sprite_slot_bits) - 1;
+
+  static const SpriteHandle* make_sprite_handle(
+    uintptr_t slot,
+    uintptr_t generation
+  ) {
+    return reinterpret_cast<const SpriteHandle*>(
+      generation << sprite_slot_bits | (slot + 1)
+    );
+  }
+
   class Handles {
   public:
 
@@ -124,7 +399,9 @@ namespace ultra::renderer {
 
     Renderer()
       : maps(nullptr),
-        world_textures_count(0) {
+        world_textures_count(0),
+        map_index(0),
+        map_lookup_time(0) {
 
       // Generate textures.
       textures.reset(new Textures(TEXTURE_COUNT));
@@ -161,13 +438,63 @@ namespace ultra::renderer {
         )
       );
 
-      // Push available texture indices onto the sprite texture index stack.
-      for (int i = 0; i < 64; i++) {
+      // Setup the map tiles texture. Its storage is specified by set_map.
+      GL_CHECK(
+        glBindTexture(
+          GL_TEXTURE_2D_ARRAY,
+          textures[TEXTURE_IDX_MAP_TILES]
+        )
+      );
+      GL_CHECK(
+        glTexParameteri(
+          GL_TEXTURE_2D_ARRAY,
+          GL_TEXTURE_MIN_FILTER,
+          GL_NEAREST
+        )
+      );
+      GL_CHECK(
+        glTexParameteri(
+          GL_TEXTURE_2D_ARRAY,
+          GL_TEXTURE_MAG_FILTER,
+          GL_NEAREST
+        )
+      );
+
+      // Setup the map tile lookup texture.
+      GL_CHECK(
+        glBindTexture(
+          GL_TEXTURE_2D,
+          textures[TEXTURE_IDX_MAP_LOOKUP]
+        )
+      );
+      GL_CHECK(
+        glTexParameteri(
+          GL_TEXTURE_2D,
+          GL_TEXTURE_MIN_FILTER,
+          GL_NEAREST
+        )
+      );
+      GL_CHECK(
+        glTexParameteri(
+          GL_TEXTURE_2D,
+          GL_TEXTURE_MAG_FILTER,
+          GL_NEAREST
+        )
+      );
+      GL_CHECK(
+        glTexStorage2D(
+          GL_TEXTURE_2D,
+          1,
+          GL_RG16UI,
+          map_lookup_width,
+          map_lookup_height
+        )
+      );
+
+      // Push available texture IDs onto the texture ID queue.
+      for (int i = 0; i < max_textures; i++) {
         texture_indices.push(i);
       }
-      for (int i = 0; i < 48; i++) {
-        sprite_indices.push(i);
-      }
     }
 
     const TilesetHandle* load_tilesets(
@@ -280,6 +607,8 @@ namespace ultra::renderer {
     void unload_world() {
       // Clear maps pointer.
       maps = nullptr;
+      // Clear animated tiles.
+      map_animated_tiles.clear();
       // Clear tile textures.
       map_tile_textures.clear();
       // Clear tileset handles.
@@ -290,6 +619,11 @@ namespace ultra::renderer {
 
     const TilesetHandle* set_map(uint16_t index) {
       map_index = index;
+      set_map_textures();
+      set_map_tile_indices();
+      set_map_tiles();
+      set_map_lookup();
+      set_map_transforms();
       return &map_tileset_handles[index];
     }
 
@@ -299,33 +633,49 @@ namespace ultra::renderer {
       const TilesetHandle* tilesets[],
       size_t tilesets_count
     ) {
-      // Combine the texture maps of the tileset handles.
-      std::unordered_map<std::string, const Texture*> texture_map;
+      // Combine the texture maps of the tileset handles. The combined map is
+      // scratch data, so it is keyed by views of the handle keys and taken
+      // from the arena.
+      using TextureMap = std::unordered_map<
+        std::string_view,
+        const Texture*,
+        std::hash<std::string_view>,
+        std::equal_to<std::string_view>,
+        ArenaAllocator<std::pair<const std::string_view, const Texture*>>
+      >;
+      ScopedArena scratch;
+      TextureMap texture_map(
+        0,
+        TextureMap::hasher(),
+        TextureMap::key_equal(),
+        scratch.get_arena()
+      );
       for (size_t i = 0; i < tilesets_count; i++) {
-        texture_map.insert(
-          tilesets[i]->texture_map.cbegin(),
-          tilesets[i]->texture_map.cend()
-        );
+        for (const auto& entry : tilesets[i]->texture_map) {
+          texture_map.insert({entry.first, entry.second});
+        }
+      }
+      // Take a free slot for the handle.
+      uint32_t slot;
+      if (free_sprite_slots.size()) {
+        slot = free_sprite_slots.back();
+        free_sprite_slots.pop_back();
+      } else {
+        slot = sprite_slots.size();
+        sprite_slots.push_back({.block = 0, .generation = 0});
       }
+      sprite_slots[slot].block = sprite_blocks.size();
       // Add sprites.
-      auto begin = this->sprites.insert(
-        this->sprites.end(),
-        sprites_count,
-        {}
-      );
-      auto it = begin;
+      sprite_blocks.push_back({.sprites = {}, .slot = slot});
+      auto& block = sprite_blocks.back().sprites;
+      block.reserve(sprites_count);
       for (size_t i = 0; i < sprites_count; i++) {
-        *it++ = {
+        block.push_back({
           .sprite = &sprites[i],
           .texture = texture_map.at(sprites[i].tileset.source),
-        };
+        });
       }
-      SpriteHandle* handle = new SpriteHandle {
-        .begin = begin,
-        .count = sprites_count,
-      };
-      sprite_handles.insert({handle, std::unique_ptr<SpriteHandle>(handle)});
-      return handle;
+      return make_sprite_handle(slot, sprite_slots[slot].generation);
     }
 
     void unload_sprites(
@@ -333,19 +683,75 @@ namespace ultra::renderer {
       size_t handles_count
     ) {
       for (size_t i = 0; i < handles_count; i++) {
-        auto end = handles[i]->begin;
-        for (size_t j = 0; j < handles[i]->count; j++) {
-          end++;
+        // Replace the block with the last block.
+        auto slot = get_sprite_slot(handles[i]);
+        auto& block = sprite_blocks[sprite_slots[slot].block];
+        if (&block != &sprite_blocks.back()) {
+          block = std::move(sprite_blocks.back());
+          sprite_slots[block.slot].block = sprite_slots[slot].block;
         }
-        sprites.erase(handles[i]->begin, end);
-        sprite_handles.erase(handles[i]);
+        sprite_blocks.pop_back();
+        // Free the slot.
+        auto& generation = sprite_slots[slot].generation;
+        generation = (generation + 1) & sprite_slot_mask;
+        free_sprite_slots.push_back(slot);
       }
     }
 
+    void update() {
+      // Resolve the current tile of each animated map tile once per frame.
+      update_map_tile_indices();
+    }
+
     uintptr_t get_texture() {
       return textures[TEXTURE_IDX_TILESETS];
     }
 
+    uintptr_t get_map_tiles_texture() {
+      return textures[TEXTURE_IDX_MAP_TILES];
+    }
+
+    uintptr_t get_map_lookup_texture() {
+      if (map_lookup_time == time || map_animated_tiles.empty()) {
+        return textures[TEXTURE_IDX_MAP_LOOKUP];
+      }
+      // Update the entries of animated tiles for the current frame, and
+      // upload the rows spanning the changed entries at once.
+      GLsizei first_row = map_lookup_height;
+      GLsizei last_row = -1;
+      for (auto tile : map_animated_tiles) {
+        GLushort index = get_map_tile_index(tile);
+        if (map_lookup_entries[2 * tile] != index) {
+          map_lookup_entries[2 * tile] = index;
+          first_row = std::min<GLsizei>(first_row, tile / map_lookup_width);
+          last_row = std::max<GLsizei>(last_row, tile / map_lookup_width);
+        }
+      }
+      if (first_row <= last_row) {
+        GL_CHECK(
+          glBindTexture(
+            GL_TEXTURE_2D,
+            textures[TEXTURE_IDX_MAP_LOOKUP]
+          )
+        );
+        GL_CHECK(
+          glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            0,
+            first_row,
+            map_lookup_width,
+            last_row - first_row + 1,
+            GL_RG_INTEGER,
+            GL_UNSIGNED_SHORT,
+            &map_lookup_entries[2 * first_row * map_lookup_width]
+          )
+        );
+      }
+      map_lookup_time = time;
+      return textures[TEXTURE_IDX_MAP_LOOKUP];
+    }
+
     void get_view_transform(
       Transform view,
       const geometry::Vector<float>& camera_position,
@@ -374,8 +780,8 @@ namespace ultra::renderer {
       Transform proj
     ) {
       mat4 translate, scale, transform;
-      mat4_translate(translate, -256 / 2, -240 / 2, 0);
-      mat4_scale(scale, 2.f / 256, -2.f / 240, 1);
+      mat4_translate(translate, -view_width / 2, -view_height / 2, 0);
+      mat4_scale(scale, 2.f / view_width, -2.f / view_height, 1);
       mat4_identity(transform);
       mat4_mult_mat4(transform, transform, translate);
       mat4_mult_mat4(transform, transform, scale);
@@ -393,51 +799,139 @@ namespace ultra::renderer {
       size_t transforms_count,
       size_t layer_index
     ) {
-      // Get tile count.
       auto tile_count = get_tile_count();
-      // Get texture indices.
-      geometry::Vector<uint32_t> texture_sizes[16];
-      uint8_t texture_indices[16];
-      auto texture = map_tile_textures[map_index].begin();
-      for (int i = 0;
-           texture != map_tile_textures[map_index].end();
-           i++, texture++) {
-        texture_indices[i] = (*texture)->index;
-        texture_sizes[i] = (*texture)->size;
-      }
-      // Populate transforms.
-      size_t count = 0;
-      for (size_t i = tile_count * layer_index;
-           i < tile_count * (1 + layer_index);
-           i++) {
-        if (count >= transforms_count) {
-          break;
+      auto count = std::min(transforms_count, tile_count);
+      copy_map_transforms(
+        vertex_transforms,
+        tex_transforms,
+        tile_count * layer_index,
+        0,
+        count
+      );
+      return count;
+    }
+
+    size_t get_map_transforms_parallel(
+      Transform vertex_transforms[],
+      Transform tex_transforms[],
+      size_t transforms_count,
+      size_t layer_index
+    ) {
+      auto tile_count = get_tile_count();
+      auto count = std::min(transforms_count, tile_count);
+      WorkerPool::get().run(
+        count,
+        map_transforms_grain,
+        [&](size_t begin, size_t end) {
+          copy_map_transforms(
+            vertex_transforms,
+            tex_transforms,
+            tile_count * layer_index,
+            begin,
+            end
+          );
         }
-        auto tile = maps[map_index].tiles[i];
-        if (tile) {
-          get_map_vertex_transform(vertex_transforms++[0], i);
-          get_map_texture_transform(
-            tex_transforms++[0],
-            tile,
-            texture_sizes,
-            texture_indices
+      );
+      return count;
+    }
+
+    size_t get_map_transforms(
+      Transform vertex_transforms[],
+      Transform tex_transforms[],
+      size_t transforms_count,
+      size_t layer_index,
+      const geometry::Vector<float>& camera_position
+    ) {
+      const auto& map = maps[map_index];
+      auto map_size = map.size.as<size_t>();
+      auto tile_count = get_tile_count();
+      // Get the tiles overlapping the view, offset by the camera as in the
+      // view transform of the layer.
+      auto offset = camera_position * map.layers[layer_index].parallax;
+      size_t begin_x, end_x, begin_y, end_y;
+      get_visible_range(begin_x, end_x, offset.x, view_width, map_size.x);
+      get_visible_range(begin_y, end_y, offset.y, view_height, map_size.y);
+      // Populate transforms of the visible non-empty tiles.
+      size_t count = 0;
+      for (size_t y = begin_y; y < end_y; y++) {
+        for (size_t x = begin_x; x < end_x; x++) {
+          if (count >= transforms_count) {
+            return count;
+          }
+          auto i = tile_count * layer_index + y * map_size.x + x;
+          auto tile = map.tiles[i];
+          if (!tile) {
+            continue;
+          }
+          memcpy(
+            vertex_transforms++[0],
+            &map_vertex_transforms[16 * i],
+            sizeof(Transform)
           );
-        } else {
-          memset(vertex_transforms++[0], 0, sizeof(Transform));
-          memset(tex_transforms++[0], 0, sizeof(Transform));
+          if (is_map_tile_animated(tile)) {
+            get_map_texture_transform(
+              tex_transforms++[0],
+              tile
+            );
+          } else {
+            memcpy(
+              tex_transforms++[0],
+              &map_tex_transforms[16 * i],
+              sizeof(Transform)
+            );
+          }
+          count++;
+        }
+      }
+      return count;
+    }
+
+    size_t get_map_instances(
+      TileInstance instances[],
+      size_t instances_count,
+      size_t layer_index
+    ) {
+      const auto& map = maps[map_index];
+      auto map_size = map.size.as<size_t>();
+      auto tile_count = get_tile_count();
+      // Populate instances of the non-empty tiles.
+      const auto* tiles = &map.tiles[tile_count * layer_index];
+      size_t count = 0;
+      for (size_t i = 0; i < tile_count && count < instances_count; i++) {
+        auto tile = tiles[i];
+        if (!tile) {
+          continue;
         }
-        count++;
+        instances[count++] = {
+          .x = static_cast<int16_t>(map.position.x + i % map_size.x),
+          .y = static_cast<int16_t>(map.position.y + i / map_size.x),
+          .tile_index = get_map_tile_index(tile),
+          .texture_index = map_texture_indices[(tile >> 12) & 0xf],
+          .flags = 0,
+        };
       }
       return count;
     }
 
+    void get_texture_rects(uint32_t rects[2 * max_textures]) {
+      for (size_t i = 0; i < 2 * max_textures; i++) {
+        rects[i] = 0;
+      }
+      for (const auto& texture : texture_list) {
+        rects[2 * texture.index] = texture.position.x
+          | texture.position.y << 12
+          | texture.layer << 24;
+        rects[2 * texture.index + 1] = texture.size.x | texture.size.y << 16;
+      }
+    }
+
     size_t get_sprite_count(
       const SpriteHandle* handles[],
       size_t handles_count
     ) {
       size_t sprite_count = 0;
       for (size_t i = 0; i < handles_count; i++) {
-        sprite_count += handles[i]->count;
+        sprite_count += get_sprite_block(handles[i]).size();
       }
       return sprite_count;
     }
@@ -452,22 +946,13 @@ namespace ultra::renderer {
     ) {
       // Get sprite count.
       size_t sprite_count = get_sprite_count(handles, handles_count);
-      // Get sprite and tileset sizes
-      geometry::Vector<uint32_t> texture_sizes[64];
-      uint8_t texture_indices[64];
-      for (auto& pair : sprite_textures) {
-        texture_sizes[pair.first->index] = pair.first->size;
-        texture_indices[pair.first->index] = pair.second;
-      }
       // Populate the sprite attributes data.
       size_t count = 0;
       for (size_t i = 0; i < handles_count; i++) {
-        auto it = handles[i]->begin;
-        for (int j = 0; j < handles[i]->count; j++, it++) {
+        for (const auto& sprite_texture : get_sprite_block(handles[i])) {
           if (count >= transforms_count) {
             break;
           }
-          const auto& sprite_texture = *it;
           get_sprite_vertex_transform(
             vertex_transforms++[0],
             sprite_texture.sprite,
@@ -478,8 +963,7 @@ namespace ultra::renderer {
           get_sprite_texture_transform(
             tex_transforms++[0],
             sprite_texture.sprite,
-            texture_sizes[sprite_texture.texture->index],
-            texture_indices[sprite_texture.texture->index]
+            *sprite_texture.texture
           );
           count++;
         }
@@ -487,8 +971,179 @@ namespace ultra::renderer {
       return count;
     }
 
+    size_t get_sprite_transforms_parallel(
+      Transform vertex_transforms[],
+      Transform tex_transforms[],
+      size_t transforms_count,
+      const SpriteHandle* handles[],
+      size_t handles_count,
+      size_t layer_index
+    ) {
+      // Get sprite count.
+      size_t sprite_count = get_sprite_count(handles, handles_count);
+      // Get the block of each handle and the index of its first sprite, so
+      // that a slice can start within any block.
+      ScopedArena scratch;
+      auto blocks = scratch.allocate<const std::vector<SpriteTexture>*>(
+        handles_count
+      );
+      auto starts = scratch.allocate<size_t>(handles_count);
+      size_t start = 0;
+      for (size_t i = 0; i < handles_count; i++) {
+        blocks[i] = &get_sprite_block(handles[i]);
+        starts[i] = start;
+        start += blocks[i]->size();
+      }
+      auto count = std::min(transforms_count, sprite_count);
+      WorkerPool::get().run(
+        count,
+        sprite_transforms_grain,
+        [&](size_t begin, size_t end) {
+          auto i = std::upper_bound(starts, starts + handles_count, begin)
+            - starts - 1;
+          for (auto index = begin; index < end; i++) {
+            const auto& block = *blocks[i];
+            for (auto j = index - starts[i];
+                 j < block.size() && index < end;
+                 j++, index++) {
+              get_sprite_vertex_transform(
+                vertex_transforms[index],
+                block[j].sprite,
+                layer_index,
+                index,
+                sprite_count
+              );
+              get_sprite_texture_transform(
+                tex_transforms[index],
+                block[j].sprite,
+                *block[j].texture
+              );
+            }
+          }
+        }
+      );
+      return count;
+    }
+
+    size_t update_sprite_transforms(
+      SpriteTransforms& transforms,
+      const SpriteHandle* handles[],
+      size_t handles_count,
+      size_t layer_index
+    ) {
+      // Get sprite count.
+      size_t sprite_count = get_sprite_count(handles, handles_count);
+      bool all = transforms.layer_index != layer_index
+        || transforms.sources.size() != sprite_count;
+      transforms.vertex_transforms.resize(16 * sprite_count);
+      transforms.tex_transforms.resize(16 * sprite_count);
+      transforms.sources.resize(sprite_count);
+      transforms.layer_index = layer_index;
+      // Rewrite the transforms of changed sprites.
+      size_t dirty_begin = sprite_count;
+      size_t dirty_end = 0;
+      size_t count = 0;
+      for (size_t i = 0; i < handles_count; i++) {
+        for (const auto& sprite_texture : get_sprite_block(handles[i])) {
+          const auto* sprite = sprite_texture.sprite;
+          auto index = count++;
+          auto& source = transforms.sources[index];
+          if (!all
+              && source.sprite == sprite
+              && source.version == sprite->version
+              && source.texture == sprite_texture.texture) {
+            continue;
+          }
+          get_sprite_vertex_transform(
+            &transforms.vertex_transforms[16 * index],
+            sprite,
+            layer_index,
+            index,
+            sprite_count
+          );
+          get_sprite_texture_transform(
+            &transforms.tex_transforms[16 * index],
+            sprite,
+            *sprite_texture.texture
+          );
+          source = {
+            .sprite = sprite,
+            .version = sprite->version,
+            .texture = sprite_texture.texture,
+          };
+          dirty_begin = std::min(dirty_begin, index);
+          dirty_end = index + 1;
+        }
+      }
+      transforms.dirty_begin = std::min(dirty_begin, dirty_end);
+      transforms.dirty_end = dirty_end;
+      return count;
+    }
+
   private:
 
+    void copy_map_transforms(
+      Transform vertex_transforms[],
+      Transform tex_transforms[],
+      size_t start,
+      size_t begin,
+      size_t end
+    ) {
+      // Copy the transforms computed by set_map.
+      memcpy(
+        vertex_transforms[begin],
+        &map_vertex_transforms[16 * (start + begin)],
+        (end - begin) * sizeof(Transform)
+      );
+      memcpy(
+        tex_transforms[begin],
+        &map_tex_transforms[16 * (start + begin)],
+        (end - begin) * sizeof(Transform)
+      );
+      // Update the texture transforms of animated tiles.
+      auto cell = std::lower_bound(
+        map_animated_cells.begin(),
+        map_animated_cells.end(),
+        start + begin
+      );
+      for (; cell != map_animated_cells.end() && *cell < start + end;
+           cell++) {
+        get_map_texture_transform(
+          tex_transforms[*cell - start],
+          maps[map_index].tiles[*cell]
+        );
+      }
+    }
+
+    uint32_t get_sprite_slot(const SpriteHandle* handle) {
+      auto token = reinterpret_cast<uintptr_t>(handle);
+      auto slot = (token & sprite_slot_mask) - 1;
+      if (slot >= sprite_slots.size()
+          || sprite_slots[slot].generation != token >> sprite_slot_bits) {
+        throw error(__FILE__, __LINE__, "invalid sprite handle");
+      }
+      return slot;
+    }
+
+    const std::vector<SpriteTexture>& get_sprite_block(
+      const SpriteHandle* handle
+    ) {
+      return sprite_blocks[sprite_slots[get_sprite_slot(handle)].block].sprites;
+    }
+
+    static void get_visible_range(
+      size_t& begin,
+      size_t& end,
+      float offset,
+      float span,
+      size_t size
+    ) {
+      auto first = std::floor(offset / 16);
+      auto last = std::ceil((offset + span) / 16);
+      begin = std::clamp<float>(first, 0, size);
+      end = std::clamp<float>(last, begin, size);
+    }
+
     void get_map_vertex_transform(
       mat4 transform,
       size_t index
@@ -499,60 +1154,167 @@ namespace ultra::renderer {
       auto layer_start = map_area * layer_index;
       auto layer_offset = index - layer_start;
       GLfloat layer_z = (15 - layer_index) / 16.f;
-      mat4 scale, translate, map, vertex;
-      mat4_scale(scale, 16, 16, layer_z);
-      mat4_translate(
-        translate,
-        16.f * (layer_offset % map_size.x),
-        16.f * (layer_offset / map_size.x),
+      const auto& position = maps[map_index].position;
+      mat4_scale_translate(
+        transform,
+        16,
+        16,
+        layer_z,
+        16.f * (layer_offset % map_size.x) + 16.f * position.x,
+        16.f * (layer_offset / map_size.x) + 16.f * position.y,
         0
       );
-      mat4_translate(
-        map,
-        16.f * maps[map_index].position.x,
-        16.f * maps[map_index].position.y,
-        0
+    }
+
+    void set_map_textures() {
+      auto texture = map_tile_textures[map_index].begin();
+      for (int i = 0;
+           texture != map_tile_textures[map_index].end();
+           i++, texture++) {
+        map_texture_indices[i] = (*texture)->index;
+        map_textures[i] = *texture;
+      }
+    }
+
+    void set_map_tiles() {
+      const auto& map = maps[map_index];
+      GL_CHECK(
+        glBindTexture(
+          GL_TEXTURE_2D_ARRAY,
+          textures[TEXTURE_IDX_MAP_TILES]
+        )
+      );
+      // Rows of tile IDs are only aligned to their size.
+      GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, sizeof(uint16_t)));
+      GL_CHECK(
+        glTexImage3D(
+          GL_TEXTURE_2D_ARRAY,
+          0,
+          GL_R16UI,
+          map.size.x,
+          map.size.y,
+          map.layers.size(),
+          0,
+          GL_RED_INTEGER,
+          GL_UNSIGNED_SHORT,
+          map.tiles.data()
+        )
       );
-      mat4_identity(vertex);
-      mat4_mult_mat4(vertex, vertex, scale);
-      mat4_mult_mat4(vertex, vertex, translate);
-      mat4_mult_mat4(vertex, vertex, map);
-      memcpy(transform, vertex, sizeof(vertex));
+      GL_CHECK(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
     }
 
-    void get_map_texture_transform(
-      mat4 transform,
-      uint16_t tile,
-      const geometry::Vector<uint32_t> texture_sizes[16],
-      uint8_t texture_indices[16]
-    ) {
-      auto tileset_index = (tile >> 12) & 0xf;
-      auto tile_index = (tile & 0xfffu) - 1;
-      const auto& tileset = maps[map_index].map_tilesets[tileset_index];
-      const auto& tile_data = tileset->tiles[tile_index];
-      if (tile_data.animation_tiles.size()) {
-        auto rem = time % tile_data.animation_duration;
-        uint32_t duration = 0;
-        for (const auto& animation_tile : tile_data.animation_tiles) {
-          duration += animation_tile.duration;
-          if (rem < duration) {
-            tile_index = animation_tile.tile_index;
-            break;
+    void set_map_tile_indices() {
+      const auto& map = maps[map_index];
+      map_tile_indices.assign(map_lookup_width * map_lookup_height, 0);
+      map_animated_tiles.clear();
+      for (size_t i = 0; i < map.map_tilesets.size() && i < 16; i++) {
+        const auto& tiles = map.map_tilesets[i]->tiles;
+        for (size_t j = 0; j < tiles.size() && j < 0xfff; j++) {
+          uint16_t tile = i << 12 | (j + 1);
+          map_tile_indices[tile] = j;
+          if (tiles[j].animation_tiles.size()) {
+            map_animated_tiles.push_back(tile);
           }
         }
       }
-      auto texture_size = texture_sizes[tileset_index];
+      update_map_tile_indices();
+    }
+
+    void update_map_tile_indices() {
+      if (maps == nullptr || map_animated_tiles.empty()) {
+        return;
+      }
+      const auto& tilesets = maps[map_index].map_tilesets;
+      for (auto tile : map_animated_tiles) {
+        const auto& tileset = tilesets[(tile >> 12) & 0xf];
+        const auto& tile_data = tileset->tiles[(tile & 0xfffu) - 1];
+        map_tile_indices[tile] = tile_data.get_animation_tile_index(time);
+      }
+    }
+
+    void set_map_lookup() {
+      const auto& map = maps[map_index];
+      // Fill the entries of every tile of the map tilesets, and keep them to
+      // update animated tiles.
+      auto& entries = map_lookup_entries;
+      entries.assign(2 * map_lookup_width * map_lookup_height, 0);
+      for (size_t i = 0; i < map.map_tilesets.size() && i < 16; i++) {
+        const auto& tiles = map.map_tilesets[i]->tiles;
+        for (size_t j = 0; j < tiles.size() && j < 0xfff; j++) {
+          uint16_t tile = i << 12 | (j + 1);
+          entries[2 * tile] = map_tile_indices[tile];
+          entries[2 * tile + 1] = map_texture_indices[i];
+        }
+      }
+      GL_CHECK(
+        glBindTexture(
+          GL_TEXTURE_2D,
+          textures[TEXTURE_IDX_MAP_LOOKUP]
+        )
+      );
+      GL_CHECK(
+        glTexSubImage2D(
+          GL_TEXTURE_2D,
+          0,
+          0,
+          0,
+          map_lookup_width,
+          map_lookup_height,
+          GL_RG_INTEGER,
+          GL_UNSIGNED_SHORT,
+          entries.data()
+        )
+      );
+      map_lookup_time = time;
+    }
+
+    void set_map_transforms() {
+      // Vertex transforms only depend on the cell of the tile, and texture
+      // transforms only change for animated tiles.
+      const auto& map = maps[map_index];
+      map_vertex_transforms.assign(16 * map.tiles.size(), 0);
+      map_tex_transforms.assign(16 * map.tiles.size(), 0);
+      map_animated_cells.clear();
+      for (size_t i = 0; i < map.tiles.size(); i++) {
+        auto tile = map.tiles[i];
+        if (!tile) {
+          continue;
+        }
+        get_map_vertex_transform(&map_vertex_transforms[16 * i], i);
+        get_map_texture_transform(
+          &map_tex_transforms[16 * i],
+          tile
+        );
+        if (is_map_tile_animated(tile)) {
+          map_animated_cells.push_back(i);
+        }
+      }
+    }
+
+    bool is_map_tile_animated(uint16_t tile) {
+      auto tileset_index = (tile >> 12) & 0xf;
+      uint16_t tile_index = (tile & 0xfffu) - 1;
+      const auto& tileset = maps[map_index].map_tilesets[tileset_index];
+      return tileset->tiles[tile_index].animation_tiles.size();
+    }
+
+    uint16_t get_map_tile_index(uint16_t tile) {
+      return map_tile_indices[tile];
+    }
+
+    void get_map_texture_transform(mat4 transform, uint16_t tile) {
+      const auto& texture = *map_textures[(tile >> 12) & 0xf];
+      auto tile_index = get_map_tile_index(tile);
       auto pos = 16 * tile_index;
       geometry::Vector<uint16_t> tex_pos(
-        pos % texture_size.x,
-        (pos / texture_size.x) * 16
+        pos % texture.size.x,
+        (pos / texture.size.x) * 16
       );
       get_texture_transform(
         transform,
         tex_pos,
         geometry::Vector<uint32_t>(16, 16),
-        texture_size,
-        texture_indices[tileset_index]
+        texture
       );
     }
 
@@ -566,86 +1328,63 @@ namespace ultra::renderer {
       auto tile_size = sprite->tileset.tile_size;
       auto sprite_z = (sprite_count - sprite_index) / (1.f + sprite_count);
       auto layer_z = (15 - layer_index + sprite_z) / 16.f;
-      mat4 scale, sprite_transform, translate, vertex;
-      mat4_scale(scale, tile_size.x, tile_size.y, layer_z);
-      mat4_from_mat3(sprite_transform, &sprite->transform[0]);
-      mat4_translate(
-        translate,
+      mat4_scale_mat3_translate(
+        transform,
+        tile_size.x,
+        tile_size.y,
+        layer_z,
+        &sprite->transform[0],
         sprite->position.x,
         sprite->position.y - tile_size.y,
         0
       );
-      mat4_identity(vertex);
-      mat4_mult_mat4(vertex, vertex, scale);
-      mat4_mult_mat4(vertex, vertex, sprite_transform);
-      mat4_mult_mat4(vertex, vertex, translate);
-      memcpy(transform, vertex, sizeof(vertex));
     }
 
     void get_sprite_texture_transform(
       mat4 texture_transform,
       const Sprite* sprite,
-      const geometry::Vector<uint32_t>& texture_size,
-      uint8_t texture_index
+      const Texture& texture
     ) {
       auto tile_size = sprite->tileset.tile_size;
       auto tile_index = sprite->tile_index;
       auto pos = tile_index * tile_size;
       auto position = geometry::Vector<uint16_t>(
-        pos.x % texture_size.x,
-        (pos.x / texture_size.x) * tile_size.y
-      );
-      mat4 to, flip, from, texture, transform;
-      mat4_translate(to, -.5f, -.5f, 0);
-      mat4_scale(
-        flip,
-        sprite->attributes.flip_x ? -1 : 1,
-        sprite->attributes.flip_y ? -1 : 1,
-        1
-      );
-      mat4_translate(from, .5f, .5f, 0);
+        pos.x % texture.size.x,
+        (pos.x / texture.size.x) * tile_size.y
+      );
       get_texture_transform(
-        texture,
+        texture_transform,
         position,
         tile_size,
-        texture_size,
-        texture_index
+        texture
+      );
+      mat4_flip_unit(
+        texture_transform,
+        sprite->attributes.flip_x,
+        sprite->attributes.flip_y
       );
-      mat4_identity(transform);
-      mat4_mult_mat4(transform, transform, to);
-      mat4_mult_mat4(transform, transform, flip);
-      mat4_mult_mat4(transform, transform, from);
-      mat4_mult_mat4(transform, transform, texture);
-      memcpy(texture_transform, transform, sizeof(transform));
     }
 
     void get_texture_transform(
       mat4 transform,
       const geometry::Vector<uint16_t>& position,
       const geometry::Vector<uint16_t>& tile_size,
-      const geometry::Vector<uint32_t>& tileset_size,
-      uint8_t texture_index
+      const Texture& texture
     ) {
-      mat4 to, flip, from, scale, translate, range, texture;
-      mat4_translate(to, 0, -.5f, 0);
-      mat4_scale(flip, 1, -1, 1);
-      mat4_translate(from, 0, .5f, 0);
-      mat4_scale(scale, tile_size.x, tile_size.y, texture_index);
-      mat4_translate(
-        translate,
-        position.x,
-        tileset_size.y - position.y - tile_size.y,
+      // The tile is flipped vertically, as the tileset image is stored upside
+      // down, then scaled and moved to its texels in the packed image.
+      GLfloat left = texture.position.x + position.x;
+      GLfloat top = texture.position.y + texture.size.y - position.y
+        - tile_size.y;
+      mat4_scale_translate(
+        transform,
+        tile_size.x * (1.f / texture_width),
+        -tile_size.y * (1.f / texture_height),
+        texture.layer,
+        left * (1.f / texture_width),
+        (tile_size.y + top) * (1.f / texture_height),
         0
       );
-      mat4_scale(range, 1.f / texture_width, 1.f / texture_height, 1);
-      mat4_identity(texture);
-      mat4_mult_mat4(texture, texture, to);
-      mat4_mult_mat4(texture, texture, flip);
-      mat4_mult_mat4(texture, texture, from);
-      mat4_mult_mat4(texture, texture, scale);
-      mat4_mult_mat4(texture, texture, translate);
-      mat4_mult_mat4(texture, texture, range);
-      memcpy(transform, texture, sizeof(texture));
     }
 
     TextureList::iterator add_tilesets(
@@ -653,45 +1392,71 @@ namespace ultra::renderer {
       size_t tilesets_count,
       Texture::Type type
     ) {
+      if (tilesets_count > texture_indices.size()) {
+        throw error(__FILE__, __LINE__, "too many tileset textures");
+      }
       auto begin = texture_list.insert(texture_list.end(), tilesets_count, {});
       auto texture = begin;
-      for (int i = 0; i < tilesets_count; i++) {
-        Image image = Image(tilesets[i]->source);
-        *texture = {
-          .tileset = tilesets[i],
-          .type = type,
-          .size = image.size,
-          .index = texture_indices.front(),
-        };
-        texture_indices.pop();
-        GL_CHECK(
-          glBindTexture(
-            GL_TEXTURE_2D_ARRAY,
-            textures[TEXTURE_IDX_TILESETS]
-          )
-        );
-        GL_CHECK(
-          glTexSubImage3D(
-            GL_TEXTURE_2D_ARRAY,
-            0,
-            0,
-            0,
-            texture->index,
-            image.size.x,
-            image.size.y,
-            1,
-            GL_RGBA,
-            GL_UNSIGNED_BYTE,
-            &image.data[0]
-          )
-        );
-        sprite_textures.insert({&*texture, sprite_indices.front()});
-        sprite_indices.pop();
-        texture++;
+      size_t added_count = 0;
+      try {
+        for (int i = 0; i < tilesets_count; i++) {
+          Image image = Image(tilesets[i]->source);
+          *texture = {
+            .tileset = tilesets[i],
+            .type = type,
+            .size = image.size,
+            .index = texture_indices.front(),
+            .layer = 0,
+            .position = {0, 0},
+          };
+          add_texture_image(*texture);
+          texture_indices.pop();
+          added_count++;
+          GL_CHECK(
+            glBindTexture(
+              GL_TEXTURE_2D_ARRAY,
+              textures[TEXTURE_IDX_TILESETS]
+            )
+          );
+          GL_CHECK(
+            glTexSubImage3D(
+              GL_TEXTURE_2D_ARRAY,
+              0,
+              texture->position.x,
+              texture->position.y,
+              texture->layer,
+              image.size.x,
+              image.size.y,
+              1,
+              GL_RGBA,
+              GL_UNSIGNED_BYTE,
+              &image.data[0]
+            )
+          );
+          texture++;
+        }
+      } catch (...) {
+        // Release the indices and layer space of the textures added so far,
+        // and remove the whole inserted range.
+        auto added_end = std::next(begin, added_count);
+        remove_textures(begin, added_count);
+        texture_list.erase(added_end, texture_list.end());
+        throw;
       }
       return begin;
     }
 
+    void add_texture_image(Texture& texture) {
+      // Pack the image in the first layer with room for it.
+      for (size_t i = 0; i < texture_layers; i++) {
+        if (tileset_layers[i].add(texture.size, texture.position)) {
+          texture.layer = i;
+          return;
+        }
+      }
+      throw error(__FILE__, __LINE__, "tileset texture is full");
+    }
+
     void remove_textures(
       TextureList::iterator begin,
       size_t count
@@ -700,11 +1465,7 @@ namespace ultra::renderer {
         auto it = begin;
         for (int i = 0; i < count; i++, it++) {
           texture_indices.push(it->index);
-          if (it->type == Texture::Type::Sprite) {
-            auto pair = sprite_textures.find(&*it);
-            sprite_indices.push(pair->second);
-            sprite_textures.erase(pair);
-          }
+          tileset_layers[it->layer].remove();
         }
         texture_list.erase(begin, it);
       }
@@ -714,24 +1475,21 @@ namespace ultra::renderer {
 
     TextureList texture_list;
 
-    std::list<SpriteTexture> sprites;
+    std::vector<SpriteBlock> sprite_blocks;
 
-    std::queue<uint8_t> texture_indices;
+    std::vector<SpriteSlot> sprite_slots;
+
+    std::vector<uint32_t> free_sprite_slots;
 
-    std::unordered_map<const Texture*, uint8_t> sprite_textures;
+    std::queue<uint8_t> texture_indices;
 
-    std::queue<uint8_t> sprite_indices;
+    TextureLayer tileset_layers[texture_layers];
 
     std::unordered_map<
       const TilesetHandle*,
       std::unique_ptr<TilesetHandle>
     > tileset_handles;
 
-    std::unordered_map<
-      const SpriteHandle*,
-      std::unique_ptr<SpriteHandle>
-    > sprite_handles;
-
     std::vector<std::list<Texture*>> map_tile_textures;
 
     std::vector<TilesetHandle> map_tileset_handles;
@@ -743,6 +1501,24 @@ namespace ultra::renderer {
     const World::Map* maps;
 
     size_t map_index;
+
+    uint8_t map_texture_indices[16];
+
+    const Texture* map_textures[16];
+
+    std::vector<GLfloat> map_vertex_transforms;
+
+    std::vector<GLfloat> map_tex_transforms;
+
+    std::vector<size_t> map_animated_cells;
+
+    std::vector<uint16_t> map_tile_indices;
+
+    std::vector<uint16_t> map_animated_tiles;
+
+    std::vector<GLushort> map_lookup_entries;
+
+    uint32_t map_lookup_time;
   };
 
   static std::unique_ptr<Renderer> renderer;
@@ -756,6 +1532,10 @@ namespace ultra::renderer {
     renderer.reset(nullptr);
   }
 
+  void update() {
+    renderer->update();
+  }
+
   const TilesetHandle* load_tilesets(
     const Tileset tilesets[],
     size_t tilesets_count
@@ -807,6 +1587,14 @@ namespace ultra::renderer {
     return renderer->get_texture();
   }
 
+  uintptr_t get_map_tiles_texture() {
+    return renderer->get_map_tiles_texture();
+  }
+
+  uintptr_t get_map_lookup_texture() {
+    return renderer->get_map_lookup_texture();
+  }
+
   void get_view_transform(
     Transform view,
     const geometry::Vector<float>& camera_position,
@@ -831,6 +1619,7 @@ namespace ultra::renderer {
     size_t transforms_count,
     size_t layer_index
   ) {
+    ALLOCATION_SCOPE(Transforms);
     return renderer->get_map_transforms(
       vertex_transforms,
       tex_transforms,
@@ -839,6 +1628,55 @@ namespace ultra::renderer {
     );
   }
 
+  size_t get_map_transforms_parallel(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    size_t layer_index
+  ) {
+    ALLOCATION_SCOPE(Transforms);
+    return renderer->get_map_transforms_parallel(
+      vertex_transforms,
+      tex_transforms,
+      transforms_count,
+      layer_index
+    );
+  }
+
+  size_t get_map_transforms(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    size_t layer_index,
+    const geometry::Vector<float>& camera_position
+  ) {
+    ALLOCATION_SCOPE(Transforms);
+    return renderer->get_map_transforms(
+      vertex_transforms,
+      tex_transforms,
+      transforms_count,
+      layer_index,
+      camera_position
+    );
+  }
+
+  size_t get_map_instances(
+    TileInstance instances[],
+    size_t instances_count,
+    size_t layer_index
+  ) {
+    ALLOCATION_SCOPE(Transforms);
+    return renderer->get_map_instances(
+      instances,
+      instances_count,
+      layer_index
+    );
+  }
+
+  void get_texture_rects(uint32_t rects[2 * max_textures]) {
+    renderer->get_texture_rects(rects);
+  }
+
   size_t get_sprite_count(
     const SpriteHandle* handles[],
     size_t handles_count
@@ -854,6 +1692,7 @@ namespace ultra::renderer {
     size_t handles_count,
     size_t layer_index
   ) {
+    ALLOCATION_SCOPE(Transforms);
     return renderer->get_sprite_transforms(
       vertex_transforms,
       tex_transforms,
@@ -864,4 +1703,38 @@ namespace ultra::renderer {
     );
   }
 
+  size_t get_sprite_transforms_parallel(
+    Transform vertex_transforms[],
+    Transform tex_transforms[],
+    size_t transforms_count,
+    const SpriteHandle* handles[],
+    size_t handles_count,
+    size_t layer_index
+  ) {
+    ALLOCATION_SCOPE(Transforms);
+    return renderer->get_sprite_transforms_parallel(
+      vertex_transforms,
+      tex_transforms,
+      transforms_count,
+      handles,
+      handles_count,
+      layer_index
+    );
+  }
+
+  size_t update_sprite_transforms(
+    SpriteTransforms& transforms,
+    const SpriteHandle* handles[],
+    size_t handles_count,
+    size_t layer_index
+  ) {
+    ALLOCATION_SCOPE(Transforms);
+    return renderer->update_sprite_transforms(
+      transforms,
+      handles,
+      handles_count,
+      layer_index
+    );
+  }
+
 }
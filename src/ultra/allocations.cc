@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "ultra/ultra.h"
+
+namespace ultra::allocations {
+
+  struct AtomicStats {
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> bytes;
+  };
+
+  static AtomicStats stats[categories_count];
+
+  static Stats frame_stats[categories_count];
+
+  static thread_local Category current = Category::Other;
+
+  void advance() {
+    for (size_t i = 0; i < categories_count; i++) {
+      frame_stats[i] = get_stats(static_cast<Category>(i));
+      stats[i].count = 0;
+      stats[i].bytes = 0;
+    }
+  }
+
+  bool is_enabled() {
+#ifdef ULTRA240_ALLOCATION_TRACKING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  Stats get_stats(Category category) {
+    auto& stats = allocations::stats[static_cast<size_t>(category)];
+    return {
+      .count = stats.count,
+      .bytes = stats.bytes,
+    };
+  }
+
+  Stats get_frame_stats(Category category) {
+    return frame_stats[static_cast<size_t>(category)];
+  }
+
+  Category get_category() {
+    return current;
+  }
+
+  Scope::Scope(Category category)
+    : previous(current) {
+    current = category;
+  }
+
+  Scope::~Scope() {
+    current = previous;
+  }
+
+#ifdef ULTRA240_ALLOCATION_TRACKING
+  static void add_allocation(size_t size) {
+    auto& category = stats[static_cast<size_t>(current)];
+    category.count.fetch_add(1, std::memory_order_relaxed);
+    category.bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  static void* allocate(size_t size) {
+    add_allocation(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+      return p;
+    }
+    throw std::bad_alloc();
+  }
+
+  static void* allocate(size_t size, std::align_val_t alignment) {
+    add_allocation(size);
+    // The size of an aligned allocation must be a multiple of its alignment.
+    auto align = static_cast<size_t>(alignment);
+    size = (std::max<size_t>(size, 1) + align - 1) / align * align;
+    if (void* p = std::aligned_alloc(align, size)) {
+      return p;
+    }
+    throw std::bad_alloc();
+  }
+#endif
+
+}
+
+#ifdef ULTRA240_ALLOCATION_TRACKING
+// The replaced operators count every heap allocation of the process. Array
+// and non-throwing forms forward to these by default.
+
+void* operator new(size_t size) {
+  return ultra::allocations::allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  return ultra::allocations::allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <ultra240/allocations.h>
+
+#ifdef ULTRA240_ALLOCATION_TRACKING
+#define ALLOCATION_SCOPE(category)                                      \
+  ultra::allocations::Scope allocation_scope(                           \
+    ultra::allocations::Category::category                              \
+  )
+#else
+#define ALLOCATION_SCOPE(category)
+#endif
+
+namespace ultra::allocations {
+
+  void advance();
+
+  // Get the category of the innermost scope open on the calling thread.
+  Category get_category();
+
+}
@@ -1,5 +1,6 @@
 #include <stdexcept>
 #include <ultra240/animated_sprite.h>
+#include "ultra/ultra.h"
 
 namespace ultra {
 
@@ -247,13 +248,23 @@ namespace ultra {
     const Controls& controls,
     bool force_restart
   ) {
+    ALLOCATION_SCOPE(Animation);
     animation = animation.set(name, controls, force_restart);
-    tile_index = animation.get_tile_index();
+    auto next_tile_index = animation.get_tile_index();
+    if (tile_index != next_tile_index) {
+      tile_index = next_tile_index;
+      mark_dirty();
+    }
   }
 
   void AnimatedSprite::update_animation() {
+    ALLOCATION_SCOPE(Animation);
     animation = animation.update();
-    tile_index = animation.get_tile_index();
+    auto next_tile_index = animation.get_tile_index();
+    if (tile_index != next_tile_index) {
+      tile_index = next_tile_index;
+      mark_dirty();
+    }
   }
 
 }
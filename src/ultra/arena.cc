@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstdint>
+#include <ultra240/arena.h>
+
+namespace ultra {
+
+  // Size of the block of each thread arena until it grows.
+  static const size_t default_arena_size = 64 * 1024;
+
+  Arena::Arena(size_t size)
+    : block(new char[size]),
+      size(size),
+      used(0),
+      peak(0),
+      overflow_used(0) {}
+
+  void* Arena::allocate(size_t size, size_t alignment) {
+    auto base = reinterpret_cast<uintptr_t>(block.get());
+    size_t offset = (base + used + alignment - 1) / alignment * alignment
+      - base;
+    if (offset + size <= this->size) {
+      used = offset + size;
+      peak = std::max(peak, used + overflow_used);
+      return block.get() + offset;
+    }
+    // Fall back to the heap until the next reset grows the block, which
+    // must then hold the overflowed bytes too.
+    overflow.emplace_back(new char[size + alignment]);
+    overflow_used += size + alignment;
+    peak = std::max(peak, used + overflow_used);
+    auto ptr = reinterpret_cast<uintptr_t>(overflow.back().get());
+    return reinterpret_cast<void*>(
+      (ptr + alignment - 1) / alignment * alignment
+    );
+  }
+
+  void Arena::reset() {
+    overflow.clear();
+    overflow_used = 0;
+    if (peak > size) {
+      size = std::max(size * 2, peak);
+      block.reset(new char[size]);
+    }
+    used = 0;
+  }
+
+  size_t Arena::get_used() const {
+    return used;
+  }
+
+  size_t Arena::get_size() const {
+    return size;
+  }
+
+  Arena& Arena::get() {
+    thread_local Arena arena(default_arena_size);
+    return arena;
+  }
+
+  ScopedArena::ScopedArena()
+    : ScopedArena(Arena::get()) {}
+
+  ScopedArena::ScopedArena(Arena& arena)
+    : arena(arena),
+      used(arena.used),
+      overflow_count(arena.overflow.size()),
+      overflow_used(arena.overflow_used) {}
+
+  ScopedArena::~ScopedArena() {
+    arena.used = used;
+    arena.overflow.resize(overflow_count);
+    arena.overflow_used = overflow_used;
+  }
+
+  Arena& ScopedArena::get_arena() const {
+    return arena;
+  }
+
+}
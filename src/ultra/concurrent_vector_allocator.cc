@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <limits>
+#include <ultra240/concurrent_vector_allocator.h>
+
+namespace ultra {
+
+  // Index marking the end of the free stack.
+  static const uint32_t none = std::numeric_limits<uint32_t>::max();
+
+  // Live pools and free cache indices. Threads flush their caches into every
+  // live pool when they exit, under the lock, so that no pool is destroyed
+  // meanwhile.
+  struct Registry {
+    std::mutex mutex;
+    std::vector<ConcurrentPool*> pools;
+    std::vector<size_t> free_indices;
+    size_t threads_count = 0;
+  };
+
+  static Registry& get_registry() {
+    static Registry registry;
+    return registry;
+  }
+
+  struct ConcurrentPool::Thread {
+
+    Thread() {
+      auto& registry = get_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      if (!registry.free_indices.empty()) {
+        index = registry.free_indices.back();
+        registry.free_indices.pop_back();
+      } else if (registry.threads_count < max_threads) {
+        index = registry.threads_count++;
+      } else {
+        index = max_threads;
+      }
+    }
+
+    ~Thread() {
+      if (index == max_threads) {
+        return;
+      }
+      auto& registry = get_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto pool : registry.pools) {
+        pool->flush(index);
+      }
+      registry.free_indices.push_back(index);
+      // Later deallocations from destructors of the thread use the stack.
+      index = max_threads;
+    }
+
+    size_t index;
+  };
+
+  // The free stack head packs a tag in the upper half and the index of the
+  // top slot in the lower half. The tag changes on every update so that a
+  // stale head never compares equal after the stack changed in between.
+  static uint64_t make_head(uint64_t head, uint32_t index) {
+    return ((head >> 32) + 1) << 32 | index;
+  }
+
+  // Slots are large enough to be addressed by index and keep every slot
+  // aligned.
+  static size_t get_slot_size(size_t size, size_t alignment) {
+    size = std::max(size, sizeof(uint32_t));
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  ConcurrentPool::ConcurrentPool(
+    size_t size,
+    size_t alignment,
+    size_t capacity
+  ) : size(get_slot_size(size, alignment)),
+      alignment(alignment),
+      capacity(capacity),
+      block(new char[this->size * capacity + alignment]),
+      next(new std::atomic<uint32_t>[capacity]),
+      head(none),
+      untouched(0),
+      caches(new Cache[max_threads]) {
+    if (capacity >= none) {
+      throw std::bad_alloc();
+    }
+    auto ptr = reinterpret_cast<uintptr_t>(block.get());
+    base = reinterpret_cast<char*>(
+      (ptr + alignment - 1) / alignment * alignment
+    );
+    for (size_t i = 0; i < max_threads; i++) {
+      caches[i].count = 0;
+    }
+    // Runs are never adjacent, so at most every other slot starts one.
+    runs.reserve(capacity / 2 + 1);
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pools.push_back(this);
+  }
+
+  ConcurrentPool::~ConcurrentPool() {
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pools.erase(
+      std::find(registry.pools.begin(), registry.pools.end(), this)
+    );
+  }
+
+  void* ConcurrentPool::allocate() {
+    uint32_t index;
+    auto cache = get_cache();
+    if (cache && cache->count) {
+      index = cache->slots[--cache->count];
+    } else if (!pop(index)
+               && !take_untouched(1, index)
+               && !take_run(1, index)) {
+      throw std::bad_alloc();
+    }
+    return base + index * size;
+  }
+
+  void* ConcurrentPool::allocate(size_t count) {
+    uint32_t index;
+    if (!take_run(count, index) && !take_untouched(count, index)) {
+      throw std::bad_alloc();
+    }
+    return base + index * size;
+  }
+
+  void ConcurrentPool::deallocate(void* p) {
+    uint32_t index = (static_cast<char*>(p) - base) / size;
+    auto cache = get_cache();
+    if (!cache) {
+      push(index);
+      return;
+    }
+    if (cache->count == cache_size) {
+      // Return half of the cache to the shared stack.
+      while (cache->count > cache_size / 2) {
+        push(cache->slots[--cache->count]);
+      }
+    }
+    cache->slots[cache->count++] = index;
+  }
+
+  void ConcurrentPool::deallocate(void* p, size_t count) {
+    uint32_t index = (static_cast<char*>(p) - base) / size;
+    std::lock_guard<std::mutex> lock(runs_mutex);
+    auto before = runs.end();
+    auto after = runs.end();
+    auto it = runs.begin();
+    while (it != runs.end()
+           && (before == runs.end() || after == runs.end())) {
+      if (it->start == index + count) {
+        after = it;
+      } else if (it->start + it->count == index) {
+        before = it;
+      }
+      it++;
+    }
+    if (before == runs.end() && after == runs.end()) {
+      runs.push_back({index, static_cast<uint32_t>(count)});
+    } else if (before == runs.end()) {
+      after->start -= count;
+      after->count += count;
+    } else if (after == runs.end()) {
+      before->count += count;
+    } else {
+      before->count += count + after->count;
+      runs.erase(after);
+    }
+  }
+
+  size_t ConcurrentPool::get_size() const {
+    return size;
+  }
+
+  size_t ConcurrentPool::get_alignment() const {
+    return alignment;
+  }
+
+  size_t ConcurrentPool::get_capacity() const {
+    return capacity;
+  }
+
+  ConcurrentPool::Cache* ConcurrentPool::get_cache() {
+    thread_local Thread thread;
+    if (thread.index < max_threads) {
+      return &caches[thread.index];
+    }
+    return nullptr;
+  }
+
+  void ConcurrentPool::flush(size_t thread_index) {
+    auto& cache = caches[thread_index];
+    while (cache.count) {
+      push(cache.slots[--cache.count]);
+    }
+  }
+
+  void ConcurrentPool::push(uint32_t index) {
+    uint64_t head = this->head.load(std::memory_order_relaxed);
+    do {
+      next[index].store(
+        static_cast<uint32_t>(head),
+        std::memory_order_relaxed
+      );
+    } while (!this->head.compare_exchange_weak(
+      head,
+      make_head(head, index),
+      std::memory_order_release,
+      std::memory_order_relaxed
+    ));
+  }
+
+  bool ConcurrentPool::pop(uint32_t& index) {
+    uint64_t head = this->head.load(std::memory_order_acquire);
+    do {
+      index = static_cast<uint32_t>(head);
+      if (index == none) {
+        return false;
+      }
+    } while (!this->head.compare_exchange_weak(
+      head,
+      make_head(head, next[index].load(std::memory_order_relaxed)),
+      std::memory_order_acquire,
+      std::memory_order_acquire
+    ));
+    return true;
+  }
+
+  bool ConcurrentPool::take_untouched(size_t count, uint32_t& index) {
+    size_t start = untouched.load(std::memory_order_relaxed);
+    do {
+      if (capacity - start < count) {
+        return false;
+      }
+    } while (!untouched.compare_exchange_weak(
+      start,
+      start + count,
+      std::memory_order_relaxed
+    ));
+    index = start;
+    return true;
+  }
+
+  bool ConcurrentPool::take_run(size_t count, uint32_t& index) {
+    std::lock_guard<std::mutex> lock(runs_mutex);
+    for (auto it = runs.begin(); it != runs.end(); it++) {
+      if (it->count >= count) {
+        index = it->start;
+        if (it->count > count) {
+          it->start += count;
+          it->count -= count;
+        } else {
+          runs.erase(it);
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  ConcurrentPoolSet::ConcurrentPoolSet(size_t capacity)
+    : capacity(capacity) {}
+
+  ConcurrentPool& ConcurrentPoolSet::get(size_t size, size_t alignment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& pool : pools) {
+      if (pool->get_alignment() == alignment
+          && pool->get_size() == get_slot_size(size, alignment)) {
+        return *pool;
+      }
+    }
+    pools.emplace_back(new ConcurrentPool(size, alignment, capacity));
+    return *pools.back();
+  }
+
+  size_t ConcurrentPoolSet::get_capacity() const {
+    return capacity;
+  }
+
+}
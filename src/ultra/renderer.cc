@@ -1,3 +1,4 @@
+#include <ultra240/arena.h>
 #include "ultra/ultra.h"
 
 namespace ultra::renderer {
@@ -6,6 +7,10 @@ namespace ultra::renderer {
 
   void advance() {
     time++;
+    update();
+    world::advance();
+    allocations::advance();
+    Arena::get().reset();
   }
 
 }
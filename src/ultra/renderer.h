@@ -8,6 +8,8 @@ namespace ultra::renderer {
 
   void quit();
 
+  void update();
+
   extern uint32_t time;
 
 }
@@ -1,7 +1,11 @@
+#include <atomic>
 #include <ultra240/sprite.h>
 
 namespace ultra {
 
+  // Next version of any sprite.
+  static std::atomic<uint64_t> next_version(0);
+
   Sprite::Sprite(
     const Tileset& tileset,
     uint16_t tile_index,
@@ -11,7 +15,8 @@ namespace ultra {
   ) : tileset(tileset),
       tile_index(tile_index),
       position(position),
-      attributes(attributes) {
+      attributes(attributes),
+      version(next_version++) {
     if (transform) {
       for (int i = 0; i < 9; i++) {
         this->transform[i] = transform[i];
@@ -27,4 +32,8 @@ namespace ultra {
     }
   }
 
+  void Sprite::mark_dirty() {
+    version = next_version++;
+  }
+
 }
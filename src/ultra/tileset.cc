@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <fstream>
+#include <ultra240/arena.h>
 #include <ultra240/tileset.h>
 #include "ultra/ultra.h"
 
@@ -67,7 +69,10 @@ namespace ultra {
     // Read collision box type count.
     uint16_t collision_box_type_count = util::read<uint16_t>(stream);
     // Read collision box offset.
-    std::vector<uint32_t> collision_box_type_offsets(collision_box_type_count);
+    ScopedArena scratch;
+    auto collision_box_type_offsets = scratch.allocate<uint32_t>(
+      collision_box_type_count
+    );
     for (int i = 0; i < collision_box_type_count; i++) {
       collision_box_type_offsets[i] = util::read<uint32_t>(stream);
     }
@@ -79,6 +84,24 @@ namespace ultra {
       animation_tiles.emplace_back(stream);
       animation_duration += animation_tiles.back().duration;
     }
+    // Build the frame lookup of the animation.
+    if (animation_duration <= animation_table_duration) {
+      animation_frames.reserve(animation_duration);
+      for (const auto& animation_tile : animation_tiles) {
+        animation_frames.insert(
+          animation_frames.end(),
+          animation_tile.duration,
+          animation_tile.tile_index
+        );
+      }
+    } else {
+      uint32_t end = 0;
+      animation_ends.reserve(animation_tiles.size());
+      for (const auto& animation_tile : animation_tiles) {
+        end += animation_tile.duration;
+        animation_ends.push_back(end);
+      }
+    }
     // Load dynamic library.
     stream.seekg(library_offset, stream.beg);
     auto library_name = util::read_string(stream);
@@ -86,19 +109,19 @@ namespace ultra {
       library.reset(new dynamic_library::Impl(library_name.c_str()));
     }
     // Load collision boxes.
-    for (auto type_offset : collision_box_type_offsets) {
-      stream.seekg(type_offset, stream.beg);
+    for (int i = 0; i < collision_box_type_count; i++) {
+      stream.seekg(collision_box_type_offsets[i], stream.beg);
       Hash type = util::read<Hash>(stream);
       uint16_t collision_box_list_count  = util::read<uint16_t>(stream);
-      std::vector<uint32_t> collision_box_list_offsets(
+      auto collision_box_list_offsets = scratch.allocate<uint32_t>(
         collision_box_list_count
       );
-      for (int i = 0; i < collision_box_list_count; i++) {
-        collision_box_list_offsets[i] = util::read<uint32_t>(stream);
+      for (int j = 0; j < collision_box_list_count; j++) {
+        collision_box_list_offsets[j] = util::read<uint32_t>(stream);
       }
       size_t box_count = 0;
-      for (auto list_offset : collision_box_list_offsets) {
-        stream.seekg(list_offset);
+      for (int j = 0; j < collision_box_list_count; j++) {
+        stream.seekg(collision_box_list_offsets[j]);
         util::read<Hash>(stream);
         box_count += util::read<uint16_t>(stream);
       }
@@ -109,11 +132,11 @@ namespace ultra {
         )
       ).first->second;
       auto it = named_list.begin();
-      for (auto list_offset : collision_box_list_offsets) {
-        stream.seekg(list_offset);
+      for (int j = 0; j < collision_box_list_count; j++) {
+        stream.seekg(collision_box_list_offsets[j]);
         Hash name = util::read<Hash>(stream);
         uint16_t count = util::read<uint16_t>(stream);
-        for (int i = 0; i < count; i++) {
+        for (int k = 0; k < count; k++) {
           named_list.emplace_back(CollisionBox<uint16_t>(name, stream));
         }
       }
@@ -164,7 +187,7 @@ namespace ultra {
     );
   }
 
-  bool Tileset::get_collision_boxes_count(
+  size_t Tileset::get_collision_boxes_count(
     uint16_t tile_index,
     Hash type
   ) const {
@@ -232,6 +255,22 @@ namespace ultra {
   Tileset::Tile::CollisionBox<float>::CollisionBox()
     : geometry::Rectangle<float>({0, 0}, {0, 0}) {}
 
+  uint16_t Tileset::Tile::get_animation_tile_index(uint32_t frame) const {
+    if (!animation_duration) {
+      return animation_tiles.front().tile_index;
+    }
+    frame %= animation_duration;
+    if (animation_frames.size()) {
+      return animation_frames[frame];
+    }
+    auto end = std::upper_bound(
+      animation_ends.begin(),
+      animation_ends.end(),
+      frame
+    );
+    return animation_tiles[end - animation_ends.begin()].tile_index;
+  }
+
   Tileset::Tile::AnimationTile::AnimationTile(std::istream& stream)
     : tile_index(util::read<uint16_t>(stream)),
       duration(util::read<uint16_t>(stream)) {}
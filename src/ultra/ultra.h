@@ -1,8 +1,11 @@
 #pragma once
 
+#include "ultra/allocations.h"
 #include "ultra/dynamic_library.h"
 #include "ultra/error.h"
 #include "ultra/image.h"
 #include "ultra/path_manager.h"
 #include "ultra/renderer.h"
 #include "ultra/util.h"
+#include "ultra/worker_pool.h"
+#include "ultra/world.h"
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <ultra240/arena.h>
+#include "ultra/allocations.h"
+#include "ultra/worker_pool.h"
+
+namespace ultra {
+
+  WorkerPool::WorkerPool(size_t threads_count)
+    : job(nullptr),
+      job_work(nullptr),
+      job_category(allocations::Category::Other),
+      job_generation(0),
+      slices_count(0),
+      next_slice(0),
+      done_slices(0),
+      stopping(false) {
+    threads.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; i++) {
+      threads.emplace_back(&WorkerPool::work, this);
+    }
+  }
+
+  WorkerPool::~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    start.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  void WorkerPool::run(
+    size_t count,
+    size_t grain,
+    Job job,
+    const void* work
+  ) {
+    if (!count) {
+      return;
+    }
+    // Split the range evenly, in slices of at least the grain size.
+    grain = std::max<size_t>(grain, 1);
+    size_t slices = std::min(threads.size() + 1, (count + grain - 1) / grain);
+    size_t size = (count + slices - 1) / slices;
+    slices = (count + size - 1) / size;
+    if (slices == 1) {
+      job(work, 0, count);
+      return;
+    }
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      this->job = job;
+      job_work = work;
+      job_category = allocations::get_category();
+      job_generation++;
+      this->count = count;
+      slices_count = slices;
+      slice_size = size;
+      next_slice = 0;
+      done_slices = 0;
+      exception = nullptr;
+    }
+    start.notify_all();
+    // Take slices on the calling thread too.
+    while (run_slice());
+    std::unique_lock<std::mutex> lock(mutex);
+    finish.wait(lock, [this] {
+      return done_slices == slices_count;
+    });
+    this->job = nullptr;
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  size_t WorkerPool::get_threads_count() const {
+    return threads.size();
+  }
+
+  WorkerPool& WorkerPool::get() {
+    static WorkerPool pool(
+      std::max(std::thread::hardware_concurrency(), 1u) - 1
+    );
+    return pool;
+  }
+
+  void WorkerPool::work() {
+    size_t generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        start.wait(lock, [&] {
+          return stopping || (job && job_generation != generation);
+        });
+        if (stopping) {
+          return;
+        }
+        generation = job_generation;
+      }
+      while (run_slice());
+      // Nothing outlives a job in the arena of a worker, so reset it to let
+      // its block grow to the usage of the slices.
+      Arena::get().reset();
+    }
+  }
+
+  bool WorkerPool::run_slice() {
+    size_t slice;
+    Job job;
+    const void* work;
+    allocations::Category category;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!this->job || next_slice == slices_count) {
+        return false;
+      }
+      slice = next_slice++;
+      job = this->job;
+      work = job_work;
+      category = job_category;
+    }
+    size_t begin = slice * slice_size;
+    size_t end = std::min(begin + slice_size, count);
+    std::exception_ptr exception;
+    try {
+      allocations::Scope scope(category);
+      job(work, begin, end);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (exception && !this->exception) {
+      this->exception = exception;
+    }
+    if (++done_slices == slices_count) {
+      finish.notify_one();
+    }
+    return true;
+  }
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ultra240/allocations.h>
+
+namespace ultra {
+
+  class WorkerPool {
+  public:
+
+    WorkerPool(size_t threads_count);
+
+    WorkerPool(const WorkerPool&) = delete;
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool();
+
+    // Run work over disjoint slices of [0, count) of at least grain items,
+    // on the workers and the calling thread, and wait for every slice. The
+    // work is called as work(begin, end) and is referenced, not copied, so
+    // that running it does not allocate.
+    template <typename Work>
+    void run(size_t count, size_t grain, const Work& work) {
+      run(count, grain, &call<Work>, &work);
+    }
+
+    size_t get_threads_count() const;
+
+    // Get the pool shared by the library, with one worker per additional
+    // hardware thread.
+    static WorkerPool& get();
+
+  private:
+
+    using Job = void (*)(const void* work, size_t begin, size_t end);
+
+    template <typename Work>
+    static void call(const void* work, size_t begin, size_t end) {
+      (*static_cast<const Work*>(work))(begin, end);
+    }
+
+    void run(size_t count, size_t grain, Job job, const void* work);
+
+    void work();
+
+    bool run_slice();
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+
+    std::condition_variable start;
+
+    std::condition_variable finish;
+
+    // Serializes calls to run.
+    std::mutex run_mutex;
+
+    Job job;
+
+    const void* job_work;
+
+    // Allocation category of the caller, in which the workers run slices.
+    allocations::Category job_category;
+
+    size_t job_generation;
+
+    size_t slice_size;
+
+    size_t slices_count;
+
+    size_t next_slice;
+
+    size_t done_slices;
+
+    size_t count;
+
+    std::exception_ptr exception;
+
+    bool stopping;
+  };
+
+}
@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <fstream>
 #include <unordered_map>
 #include <memory>
+#include <ultra240/arena.h>
 #include <ultra240/world.h>
 #include "ultra/ultra.h"
 
@@ -8,7 +12,89 @@ namespace ultra {
 
   const static float epsilon = 1.f / 256;
 
-  World::World(const std::string& name) {
+#ifdef ULTRA240_COLLISION_STATS
+#define COLLISION_STAT(stats, name) (stats).name++
+#else
+#define COLLISION_STAT(stats, name) (void) (stats)
+#endif
+
+  struct AtomicCollisionStats {
+    std::atomic<uint32_t> queries;
+    std::atomic<uint32_t> boundaries_visited;
+    std::atomic<uint32_t> intersection_tests;
+    std::atomic<uint32_t> direction_rejects;
+    std::atomic<uint32_t> adjust_restarts;
+    std::atomic<uint32_t> stuck_detections;
+  };
+
+  static AtomicCollisionStats collision_stats;
+
+  // Written by advance while queries may read it from other threads, so it is
+  // atomic like the running counts.
+  static AtomicCollisionStats frame_collision_stats;
+
+  static void add_collision_stats(
+    [[maybe_unused]] const World::CollisionStats& stats
+  ) {
+#ifdef ULTRA240_COLLISION_STATS
+    auto order = std::memory_order_relaxed;
+    collision_stats.queries.fetch_add(1, order);
+    collision_stats.boundaries_visited.fetch_add(
+      stats.boundaries_visited,
+      order
+    );
+    collision_stats.intersection_tests.fetch_add(
+      stats.intersection_tests,
+      order
+    );
+    collision_stats.direction_rejects.fetch_add(
+      stats.direction_rejects,
+      order
+    );
+    collision_stats.adjust_restarts.fetch_add(stats.adjust_restarts, order);
+    collision_stats.stuck_detections.fetch_add(stats.stuck_detections, order);
+#endif
+  }
+
+  namespace world {
+
+    void advance() {
+      // Exchange each count so that none added in between is lost.
+      auto& frame = frame_collision_stats;
+      frame.queries = collision_stats.queries.exchange(0);
+      frame.boundaries_visited =
+        collision_stats.boundaries_visited.exchange(0);
+      frame.intersection_tests =
+        collision_stats.intersection_tests.exchange(0);
+      frame.direction_rejects = collision_stats.direction_rejects.exchange(0);
+      frame.adjust_restarts = collision_stats.adjust_restarts.exchange(0);
+      frame.stuck_detections = collision_stats.stuck_detections.exchange(0);
+    }
+
+  }
+
+  static World::CollisionStats load_collision_stats(
+    const AtomicCollisionStats& stats
+  ) {
+    return {
+      .queries = stats.queries,
+      .boundaries_visited = stats.boundaries_visited,
+      .intersection_tests = stats.intersection_tests,
+      .direction_rejects = stats.direction_rejects,
+      .adjust_restarts = stats.adjust_restarts,
+      .stuck_detections = stats.stuck_detections,
+    };
+  }
+
+  World::CollisionStats World::get_collision_stats() {
+    return load_collision_stats(collision_stats);
+  }
+
+  World::CollisionStats World::get_frame_collision_stats() {
+    return load_collision_stats(frame_collision_stats);
+  }
+
+  World::World(const std::string& name, size_t dynamic_boundaries_count) {
     auto path = ultra::path_manager::data_dir + "/world/" + name + ".bin";
     std::ifstream stream(path);
     // Read number of maps.
@@ -49,20 +135,263 @@ namespace ultra {
       }
     }
     // Create line segments from points lists.
-    boundaries.reset(new Boundaries(VectorAllocator<Boundary>(lines_count)));
+    boundaries.reset(new Boundaries(lines_count + dynamic_boundaries_count));
     for (uint i = 0; i < boundaries_count; i++) {
       auto& boundary = points[i];
       uint8_t flags = boundary_flags[i];
+      uint8_t layers = flags & Boundary::Flags::Layers;
+      if (!layers) {
+        layers = Boundary::default_layers;
+      }
       auto a = boundary.cbegin();
       auto b = std::next(a);
       while (b != boundary.cend()) {
-        boundaries->emplace_back(flags, *a, *b);
+        boundaries->emplace_back(flags, layers, *a, *b);
         a++;
         b++;
       }
     }
   }
 
+  // Quantized bounds of a query, compared against quantized boundaries.
+  struct QuantizedBounds {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+  };
+
+  static int32_t saturate(float value) {
+    return std::clamp<float>(
+      value,
+      std::numeric_limits<int16_t>::min(),
+      std::numeric_limits<int16_t>::max()
+    );
+  }
+
+  static QuantizedBounds quantize_bounds(
+    const World::Boundaries& boundaries,
+    geometry::Vector<float> min,
+    geometry::Vector<float> max
+  ) {
+    // Quantized endpoints are off by at most half a pixel and intersections
+    // are tested with a tolerance, so the bounds are grown by a pixel.
+    min -= boundaries.get_origin() + 1.f;
+    max -= boundaries.get_origin() - 1.f;
+    return {
+      saturate(std::floor(min.x)),
+      saturate(std::floor(min.y)),
+      saturate(std::ceil(max.x)),
+      saturate(std::ceil(max.y)),
+    };
+  }
+
+  static bool is_outside(
+    const World::Boundaries::Quantized& boundary,
+    const QuantizedBounds& bounds
+  ) {
+    return std::max(boundary.px, boundary.qx) < bounds.left
+      || std::min(boundary.px, boundary.qx) > bounds.right
+      || std::max(boundary.py, boundary.qy) < bounds.top
+      || std::min(boundary.py, boundary.qy) > bounds.bottom;
+  }
+
+  World::Boundaries::Boundaries(size_t capacity)
+    : version(0),
+      changes() {
+    boundaries.reserve(capacity);
+    quantized.reserve(capacity);
+    erased.reserve(capacity);
+  }
+
+  World::Boundaries::const_iterator World::Boundaries::begin() const {
+    return boundaries.cbegin();
+  }
+
+  World::Boundaries::const_iterator World::Boundaries::end() const {
+    return boundaries.cend();
+  }
+
+  World::Boundaries::const_iterator World::Boundaries::cbegin() const {
+    return boundaries.cbegin();
+  }
+
+  World::Boundaries::const_iterator World::Boundaries::cend() const {
+    return boundaries.cend();
+  }
+
+  size_t World::Boundaries::size() const {
+    return boundaries.size();
+  }
+
+  bool World::Boundaries::empty() const {
+    return boundaries.empty();
+  }
+
+  const World::Boundary& World::Boundaries::operator[](size_t index) const {
+    return boundaries[index];
+  }
+
+  void World::Boundaries::push_back(const Boundary& boundary) {
+    insert(&boundary, 1);
+  }
+
+  size_t World::Boundaries::insert(
+    const Boundary inserted[],
+    size_t count
+  ) {
+    // The capacity is never exceeded so that references to boundaries held
+    // by collisions remain valid.
+    size_t index = boundaries.size();
+    if (boundaries.capacity() - index < count) {
+      // Look for a run of tombstones long enough to hold the boundaries.
+      size_t run = 0;
+      for (index = 0; index < boundaries.size() && run < count; index++) {
+        run = erased[index] ? run + 1 : 0;
+      }
+      if (run < count) {
+        throw std::bad_alloc();
+      }
+      index -= count;
+    }
+    bool moved = boundaries.empty();
+    if (moved) {
+      origin = {std::round(inserted[0].p.x), std::round(inserted[0].p.y)};
+    }
+    for (size_t i = 0; i < count; i++) {
+      assign(index + i, inserted[i]);
+    }
+    add_change(&quantized[index], count);
+    if (moved) {
+      // Earlier changes were quantized relative to another origin.
+      auto& change = changes[version % changes_count];
+      change.left = change.top = std::numeric_limits<int16_t>::min();
+      change.right = change.bottom = std::numeric_limits<int16_t>::max();
+    }
+    return index;
+  }
+
+  void World::Boundaries::set(
+    size_t index,
+    const geometry::Vector<float>& p,
+    const geometry::Vector<float>& q
+  ) {
+    auto& boundary = boundaries[index];
+    boundary.p = p;
+    boundary.q = q;
+    auto before = quantized[index];
+    quantized[index] = quantize(boundary);
+    add_change(before, quantized[index]);
+  }
+
+  void World::Boundaries::erase(size_t index, size_t count) {
+    add_change(&quantized[index], count);
+    // Erased boundaries are left in place without layers.
+    for (size_t i = index; i < index + count; i++) {
+      boundaries[i].layers = 0;
+      quantized[i].layers = 0;
+      erased[i] = true;
+    }
+    // Tombstones at the end of the collection are released.
+    size_t size = boundaries.size();
+    while (size > 0 && erased[size - 1]) {
+      size--;
+    }
+    boundaries.resize(size);
+    quantized.resize(size);
+    erased.resize(size);
+  }
+
+  const World::Boundaries::Quantized*
+  World::Boundaries::get_quantized() const {
+    return quantized.data();
+  }
+
+  const geometry::Vector<float>& World::Boundaries::get_origin() const {
+    return origin;
+  }
+
+  uint32_t World::Boundaries::get_version() const {
+    return version;
+  }
+
+  bool World::Boundaries::is_unchanged(
+    uint32_t version,
+    const geometry::Vector<float>& min,
+    const geometry::Vector<float>& max
+  ) const {
+    if (this->version - version > changes_count) {
+      return false;
+    }
+    auto bounds = quantize_bounds(*this, min, max);
+    for (auto v = version + 1; v != this->version + 1; v++) {
+      const auto& change = changes[v % changes_count];
+      if (change.right >= bounds.left
+          && change.left <= bounds.right
+          && change.bottom >= bounds.top
+          && change.top <= bounds.bottom) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void World::Boundaries::assign(size_t index, const Boundary& boundary) {
+    if (index == boundaries.size()) {
+      boundaries.push_back(boundary);
+      quantized.push_back(quantize(boundary));
+      erased.push_back(false);
+    } else {
+      boundaries[index] = boundary;
+      quantized[index] = quantize(boundary);
+      erased[index] = false;
+    }
+  }
+
+  void World::Boundaries::add_change(
+    const Quantized quantized[],
+    size_t count
+  ) {
+    auto& change = changes[++version % changes_count];
+    change = {
+      .version = version,
+      .left = std::numeric_limits<int16_t>::max(),
+      .top = std::numeric_limits<int16_t>::max(),
+      .right = std::numeric_limits<int16_t>::min(),
+      .bottom = std::numeric_limits<int16_t>::min(),
+    };
+    for (size_t i = 0; i < count; i++) {
+      const auto& boundary = quantized[i];
+      change.left = std::min({change.left, boundary.px, boundary.qx});
+      change.top = std::min({change.top, boundary.py, boundary.qy});
+      change.right = std::max({change.right, boundary.px, boundary.qx});
+      change.bottom = std::max({change.bottom, boundary.py, boundary.qy});
+    }
+  }
+
+  void World::Boundaries::add_change(
+    const Quantized& before,
+    const Quantized& after
+  ) {
+    Quantized quantized[] = {before, after};
+    add_change(quantized, 2);
+  }
+
+  World::Boundaries::Quantized World::Boundaries::quantize(
+    const Boundary& boundary
+  ) const {
+    auto p = boundary.p - origin;
+    auto q = boundary.q - origin;
+    return {
+      .px = static_cast<int16_t>(saturate(std::round(p.x))),
+      .py = static_cast<int16_t>(saturate(std::round(p.y))),
+      .qx = static_cast<int16_t>(saturate(std::round(q.x))),
+      .qy = static_cast<int16_t>(saturate(std::round(q.y))),
+      .flags = boundary.flags,
+      .layers = boundary.layers,
+    };
+  }
+
   static bool can_skip_corner_boundary(
     size_t i,
     const World::Boundary& boundary
@@ -115,16 +444,51 @@ namespace ultra {
     return false;
   }
 
-  std::pair<bool, geometry::Vector<float>> World::can_fit_collision_boxes(
+  static World::FitCache::Transit get_transit(
+    const geometry::Vector<float>& from,
+    const geometry::Vector<float>& to
+  ) {
+    if (std::abs((from - to).length()) < epsilon) {
+      return {{}, 0, false};
+    }
+    geometry::LineSegment<float> segment(from, to);
+    return {segment, segment.slope(), true};
+  }
+
+  // Boundaries gathered once for several fits within the same bounds.
+  struct CandidateBoundaries {
+    QuantizedBounds bounds;
+    std::vector<size_t, ArenaAllocator<size_t>> indices;
+  };
+
+  static bool contains(
+    const QuantizedBounds& outer,
+    const QuantizedBounds& inner
+  ) {
+    return inner.left >= outer.left
+      && inner.top >= outer.top
+      && inner.right <= outer.right
+      && inner.bottom <= outer.bottom;
+  }
+
+  static std::pair<bool, geometry::Vector<float>> fit_collision_boxes(
     const Tileset::Tile::CollisionBox<float> prev_collision_boxes[],
     size_t prev_collision_boxes_count,
     const Tileset::Tile::CollisionBox<float> next_collision_boxes[],
     size_t next_collision_boxes_count,
-    const Boundaries& boundaries,
-    bool check_transits
+    const World::FitCache::Transit cached_transits[],
+    const World::Boundaries& boundaries,
+    const CandidateBoundaries* candidates,
+    bool check_transits,
+    uint8_t layers,
+    World::CollisionStats& stats
   ) {
     bool moved[4] = {false, false, false, false};
     geometry::Vector<float> offset;
+    ScopedArena scratch;
+    auto transits = scratch.allocate<World::FitCache::Transit>(
+      4 * prev_collision_boxes_count
+    );
   adjust_position:
     for (size_t i = 0; i < next_collision_boxes_count; i++) {
       const auto& box = next_collision_boxes[i];
@@ -135,66 +499,93 @@ namespace ultra {
         pos + box.size,
         pos + box.size.as_y(),
       };
-      geometry::LineSegment<float> transits[prev_collision_boxes_count][4];
-      bool is_line[prev_collision_boxes_count][4];
       if (check_transits) {
-        geometry::LineSegment<float>* t = transits[0];
-        bool* l = is_line[0];
         for (size_t j = 0; j < prev_collision_boxes_count; j++) {
           const auto& box = prev_collision_boxes[j];
           auto pos = box.position + offset;
-          if (std::abs((pos - corners[0]).length()) < epsilon) {
-            *l++ = false;
-            t++;
-          } else {
-            *l++ = true;
-            *t++ = {pos, corners[0]};
-          }
-          if (std::abs((pos + box.size.as_x() - corners[1]).length())
-              < epsilon) {
-            *l++ = false;
-            t++;
-          } else {
-            *l++ = true;
-            *t++ = {pos + box.size.as_x(), corners[1]};
-          }
-          if (std::abs((pos + box.size - corners[2]).length())
-              < epsilon) {
-            *l++ = false;
-            t++;
-          } else {
-            *l++ = true;
-            *t++ = {pos + box.size, corners[2]};
-          }
-          if (std::abs((pos + box.size.as_y() - corners[3]).length())
-              < epsilon) {
-            *l++ = false;
-            t++;
+          geometry::Vector<float> prev_corners[] = {
+            pos,
+            pos + box.size.as_x(),
+            pos + box.size,
+            pos + box.size.as_y(),
+          };
+          if (cached_transits) {
+            // Only the end points depend on the position.
+            auto cached = &cached_transits[
+              4 * (i * prev_collision_boxes_count + j)
+            ];
+            for (int k = 0; k < 4; k++) {
+              new (&transits[4 * j + k]) World::FitCache::Transit {
+                {prev_corners[k], corners[k]},
+                cached[k].slope,
+                cached[k].is_line,
+              };
+            }
           } else {
-            *l++ = true;
-            *t++ = {pos + box.size.as_y(), corners[3]};
+            for (int k = 0; k < 4; k++) {
+              new (&transits[4 * j + k]) World::FitCache::Transit(
+                get_transit(prev_corners[k], corners[k])
+              );
+            }
           }
         }
       }
-      for (const auto& boundary : boundaries) {
+      // Only boundaries within the bounds of the box and the transits of the
+      // previous boxes can affect the fit.
+      auto min = pos;
+      auto max = pos + box.size;
+      if (check_transits) {
+        for (size_t j = 0; j < prev_collision_boxes_count; j++) {
+          const auto& box = prev_collision_boxes[j];
+          auto pos = box.position + offset;
+          min.x = std::min(min.x, pos.x);
+          min.y = std::min(min.y, pos.y);
+          max.x = std::max(max.x, pos.x + box.size.x);
+          max.y = std::max(max.y, pos.y + box.size.y);
+        }
+      }
+      auto bounds = quantize_bounds(boundaries, min, max);
+      auto quantized = boundaries.get_quantized();
+      // Gathered candidate boundaries are used unless the position was
+      // adjusted beyond their bounds.
+      const size_t* indices = nullptr;
+      size_t count = boundaries.size();
+      if (candidates && contains(candidates->bounds, bounds)) {
+        indices = candidates->indices.data();
+        count = candidates->indices.size();
+      }
+      for (size_t m = 0; m < count; m++) {
+        size_t n = indices ? indices[m] : m;
+        COLLISION_STAT(stats, boundaries_visited);
+        if (!(quantized[n].layers & layers)
+            || is_outside(quantized[n], bounds)) {
+          continue;
+        }
+        const auto& boundary = boundaries[n];
         const auto& p = boundary.p;
         const auto& q = boundary.q;
         if (check_transits && prev_collision_boxes_count) {
           for (size_t j = 0; j < prev_collision_boxes_count; j++) {
             for (int k = 0; k < 4; k++) {
-              if (!can_skip_corner_boundary(k, boundary) && is_line[j][k]) {
-                const auto& t = transits[j][k];
-                if (t.slope() == boundary.slope()) {
+              const auto& transit = transits[4 * j + k];
+              if (can_skip_corner_boundary(k, boundary)) {
+                COLLISION_STAT(stats, direction_rejects);
+              } else if (transit.is_line) {
+                const auto& t = transit.segment;
+                if (transit.slope == boundary.slope()) {
                   continue;
                 }
+                COLLISION_STAT(stats, intersection_tests);
                 auto intersection = boundary.intersection(t, epsilon);
                 if (!intersection.is_nan()) {
                   auto s = intersection - corners[k];
                   if (is_stuck(s, moved)) {
+                    COLLISION_STAT(stats, stuck_detections);
                     return std::make_pair(false, geometry::Vector<float>{0, 0});
                   }
                   if (s.x || s.y) {
                     offset += s;
+                    COLLISION_STAT(stats, adjust_restarts);
                     goto adjust_position;
                   }
                 }
@@ -210,8 +601,11 @@ namespace ultra {
           };
           for (int j = 0; j < 4; j++) {
             const auto& edge = edges[j];
-            if (!can_skip_edge_boundary(j, edge, boundary)) {
+            if (can_skip_edge_boundary(j, edge, boundary)) {
+              COLLISION_STAT(stats, direction_rejects);
+            } else {
               // Get intersection between new edge and boundary.
+              COLLISION_STAT(stats, intersection_tests);
               auto intersection = boundary.intersection(edge, epsilon);
               if (!intersection.is_nan()) {
                 if (intersection == edge.p
@@ -239,6 +633,7 @@ namespace ultra {
                       {pos + box.size.as_y(), pos},
                     };
                     for (const auto& edge : edges) {
+                      COLLISION_STAT(stats, intersection_tests);
                       auto inter = boundary.intersection(edge, epsilon);
                       if (!inter.is_nan()
                           && inter != edge.p
@@ -318,6 +713,7 @@ namespace ultra {
                   boundary.normal().slope()
                 );
                 // Get intersection between line of expansion and boundary.
+                COLLISION_STAT(stats, intersection_tests);
                 auto exp_intersection = line.intersection(boundary, epsilon);
                 if (exp_intersection.is_nan()) {
                   // If there's no intersection, adjust position in one
@@ -392,10 +788,12 @@ namespace ultra {
                   s = exp_intersection - corner;
                 }
                 if (is_stuck(s, moved)) {
+                  COLLISION_STAT(stats, stuck_detections);
                   return std::make_pair(false, geometry::Vector<float>{0, 0});
                 }
                 if (s.x || s.y) {
                   offset += s;
+                  COLLISION_STAT(stats, adjust_restarts);
                   goto adjust_position;
                 }
               }
@@ -407,26 +805,511 @@ namespace ultra {
     return std::make_pair(true, offset);
   }
 
-  std::pair<bool, World::BoundaryCollision> World::get_boundary_collision(
+  std::pair<bool, geometry::Vector<float>> World::can_fit_collision_boxes(
+    const Tileset::Tile::CollisionBox<float> prev_collision_boxes[],
+    size_t prev_collision_boxes_count,
+    const Tileset::Tile::CollisionBox<float> next_collision_boxes[],
+    size_t next_collision_boxes_count,
+    const Boundaries& boundaries,
+    bool check_transits,
+    uint8_t layers
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    CollisionStats stats = {};
+    auto result = fit_collision_boxes(
+      prev_collision_boxes,
+      prev_collision_boxes_count,
+      next_collision_boxes,
+      next_collision_boxes_count,
+      nullptr,
+      boundaries,
+      nullptr,
+      check_transits,
+      layers,
+      stats
+    );
+    add_collision_stats(stats);
+    return result;
+  }
+
+  std::pair<bool, geometry::Vector<float>> World::can_fit_collision_boxes(
+    const FitCache::Entry& entry,
+    const geometry::Vector<float>& position,
+    const Boundaries& boundaries,
+    bool check_transits,
+    uint8_t layers
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    // Position the cached collision boxes.
+    size_t prev_count = entry.prev_collision_boxes.size();
+    size_t next_count = entry.next_collision_boxes.size();
+    ScopedArena scratch;
+    auto prev_collision_boxes = scratch.allocate<
+      Tileset::Tile::CollisionBox<float>
+    >(prev_count);
+    for (size_t i = 0; i < prev_count; i++) {
+      new (&prev_collision_boxes[i]) Tileset::Tile::CollisionBox<float>(
+        entry.prev_collision_boxes[i]
+      );
+      prev_collision_boxes[i].position += position;
+    }
+    auto next_collision_boxes = scratch.allocate<
+      Tileset::Tile::CollisionBox<float>
+    >(next_count);
+    for (size_t i = 0; i < next_count; i++) {
+      new (&next_collision_boxes[i]) Tileset::Tile::CollisionBox<float>(
+        entry.next_collision_boxes[i]
+      );
+      next_collision_boxes[i].position += position;
+    }
+    CollisionStats stats = {};
+    auto result = fit_collision_boxes(
+      prev_collision_boxes,
+      prev_count,
+      next_collision_boxes,
+      next_count,
+      entry.transits.data(),
+      boundaries,
+      nullptr,
+      check_transits,
+      layers,
+      stats
+    );
+    add_collision_stats(stats);
+    return result;
+  }
+
+  std::pair<size_t, geometry::Vector<float>> World::find_first_fit(
+    const Tileset::Tile::CollisionBox<float> prev_collision_boxes[],
+    size_t prev_collision_boxes_count,
+    const FitCandidate candidates[],
+    size_t candidates_count,
+    const Boundaries& boundaries,
+    bool check_transits,
+    uint8_t layers,
+    bool parallel
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    // Gather the boundaries near any of the collision boxes once for all
+    // candidates. The bounds are grown so that small position adjustments
+    // stay within them.
+    static const float margin = 16;
+    geometry::Vector<float> min(
+      std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::infinity()
+    );
+    auto max = min * -1.f;
+    auto grow = [&min, &max](const Tileset::Tile::CollisionBox<float>& box) {
+      min.x = std::min(min.x, box.position.x);
+      min.y = std::min(min.y, box.position.y);
+      max.x = std::max(max.x, box.position.x + box.size.x);
+      max.y = std::max(max.y, box.position.y + box.size.y);
+    };
+    for (size_t i = 0; i < prev_collision_boxes_count; i++) {
+      grow(prev_collision_boxes[i]);
+    }
+    for (size_t i = 0; i < candidates_count; i++) {
+      for (size_t j = 0; j < candidates[i].collision_boxes_count; j++) {
+        grow(candidates[i].collision_boxes[j]);
+      }
+    }
+    ScopedArena scratch;
+    CandidateBoundaries gathered = {
+      .bounds = quantize_bounds(boundaries, min - margin, max + margin),
+      .indices = std::vector<size_t, ArenaAllocator<size_t>>(
+        scratch.get_arena()
+      ),
+    };
+    auto quantized = boundaries.get_quantized();
+    for (size_t n = 0; n < boundaries.size(); n++) {
+      if ((quantized[n].layers & layers)
+          && !is_outside(quantized[n], gathered.bounds)) {
+        gathered.indices.push_back(n);
+      }
+    }
+    auto fit = [&](size_t i) {
+      CollisionStats stats = {};
+      auto result = fit_collision_boxes(
+        prev_collision_boxes,
+        prev_collision_boxes_count,
+        candidates[i].collision_boxes,
+        candidates[i].collision_boxes_count,
+        nullptr,
+        boundaries,
+        &gathered,
+        check_transits,
+        layers,
+        stats
+      );
+      add_collision_stats(stats);
+      return result;
+    };
+    if (parallel && candidates_count > 1) {
+      auto results = scratch.allocate<std::pair<bool, geometry::Vector<float>>>(
+        candidates_count
+      );
+      WorkerPool::get().run(
+        candidates_count,
+        1,
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+            new (&results[i]) std::pair<bool, geometry::Vector<float>>(fit(i));
+          }
+        }
+      );
+      for (size_t i = 0; i < candidates_count; i++) {
+        if (results[i].first) {
+          return std::make_pair(i, results[i].second);
+        }
+      }
+      return std::make_pair(candidates_count, geometry::Vector<float>{0, 0});
+    }
+    for (size_t i = 0; i < candidates_count; i++) {
+      auto result = fit(i);
+      if (result.first) {
+        return std::make_pair(i, result.second);
+      }
+    }
+    return std::make_pair(candidates_count, geometry::Vector<float>{0, 0});
+  }
+
+  const World::FitCache::Entry& World::FitCache::get(
+    const Tileset& tileset,
+    Hash type,
+    uint16_t prev_tile_index,
+    Tileset::Attributes prev_attributes,
+    uint16_t next_tile_index,
+    Tileset::Attributes next_attributes
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    Key key = {
+      .tileset = &tileset,
+      .type = type,
+      .prev_tile_index = prev_tile_index,
+      .next_tile_index = next_tile_index,
+      .attributes = static_cast<uint8_t>(
+        prev_attributes.flip_x
+        | prev_attributes.flip_y << 1
+        | next_attributes.flip_x << 2
+        | next_attributes.flip_y << 3
+      ),
+    };
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      return it->second;
+    }
+    Entry entry;
+    // Get the collision boxes relative to the entity position.
+    entry.prev_collision_boxes.resize(
+      tileset.get_collision_boxes_count(prev_tile_index, type)
+    );
+    tileset.get_collision_boxes(
+      entry.prev_collision_boxes.data(),
+      prev_tile_index,
+      type,
+      {0, 0},
+      prev_attributes
+    );
+    entry.next_collision_boxes.resize(
+      tileset.get_collision_boxes_count(next_tile_index, type)
+    );
+    tileset.get_collision_boxes(
+      entry.next_collision_boxes.data(),
+      next_tile_index,
+      type,
+      {0, 0},
+      next_attributes
+    );
+    // Compute the transits of the previous corners to the next corners.
+    auto& transits = entry.transits;
+    transits.reserve(
+      4 * entry.prev_collision_boxes.size() * entry.next_collision_boxes.size()
+    );
+    for (const auto& next : entry.next_collision_boxes) {
+      auto pos = next.position;
+      geometry::Vector<float> corners[] = {
+        pos,
+        pos + next.size.as_x(),
+        pos + next.size,
+        pos + next.size.as_y(),
+      };
+      for (const auto& prev : entry.prev_collision_boxes) {
+        auto pos = prev.position;
+        transits.push_back(get_transit(pos, corners[0]));
+        transits.push_back(get_transit(pos + prev.size.as_x(), corners[1]));
+        transits.push_back(get_transit(pos + prev.size, corners[2]));
+        transits.push_back(get_transit(pos + prev.size.as_y(), corners[3]));
+      }
+    }
+    return entries.emplace(key, std::move(entry)).first->second;
+  }
+
+  void World::FitCache::clear() {
+    entries.clear();
+  }
+
+  bool World::FitCache::Key::operator==(const Key& rhs) const {
+    return tileset == rhs.tileset
+      && type == rhs.type
+      && prev_tile_index == rhs.prev_tile_index
+      && next_tile_index == rhs.next_tile_index
+      && attributes == rhs.attributes;
+  }
+
+  size_t World::FitCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<const Tileset*>()(key.tileset);
+    hash = hash * 31 + key.type;
+    hash = hash * 31 + key.prev_tile_index;
+    hash = hash * 31 + key.next_tile_index;
+    hash = hash * 31 + key.attributes;
+    return hash;
+  }
+
+  static size_t first_boundary(
+    const World::Boundaries& boundaries,
+    const geometry::Vector<float>& force
+  ) {
+    // Boundaries are scanned in reverse unless the force is to the right.
+    if (force.x > 0) {
+      return 0;
+    }
+    return boundaries.size() - 1;
+  }
+
+  static size_t last_boundary(
+    const World::Boundaries& boundaries,
+    const geometry::Vector<float>& force
+  ) {
+    if (force.x > 0) {
+      return boundaries.size();
+    }
+    return -1;
+  }
+
+  static void next_boundary(
+    size_t& curr,
+    const geometry::Vector<float>& force
+  ) {
+    if (force.x > 0) {
+      curr++;
+    } else {
+      curr--;
+    }
+  }
+
+  // Distance field vertices are stored in square blocks of 16x16 vertices.
+  static const int32_t distance_block_shift = 4;
+
+  static const int32_t distance_block_size = 1 << distance_block_shift;
+
+  static uint64_t get_distance_block_key(int32_t x, int32_t y) {
+    uint32_t bx = x >> distance_block_shift;
+    uint32_t by = y >> distance_block_shift;
+    return (static_cast<uint64_t>(bx) << 32) | by;
+  }
+
+  static size_t get_distance_vertex_index(int32_t x, int32_t y) {
+    return (y & (distance_block_size - 1)) * distance_block_size
+      + (x & (distance_block_size - 1));
+  }
+
+  static float get_segment_distance(
+    const geometry::Vector<float>& point,
+    const World::Boundary& boundary
+  ) {
+    auto v = boundary.q - boundary.p;
+    auto w = point - boundary.p;
+    float t = 0;
+    float length = v.dot(v);
+    if (length > 0) {
+      t = std::clamp(w.dot(v) / length, 0.f, 1.f);
+    }
+    return (w - v * t).length();
+  }
+
+  World::DistanceField::DistanceField(
+    const Boundaries& boundaries,
+    float cell_size,
+    float max_distance
+  ) : cell_size(cell_size),
+      max_distance(max_distance),
+      static_count(0) {
+    size_t count = 0;
+    for (const auto& boundary : boundaries) {
+      count++;
+      if (boundary.flags & Boundary::Flags::Dynamic) {
+        continue;
+      }
+      static_count = count;
+      // Update every vertex within the maximum distance of the bounding box
+      // of the boundary.
+      int32_t x0 = std::floor(
+        (std::min(boundary.p.x, boundary.q.x) - max_distance) / cell_size
+      );
+      int32_t x1 = std::ceil(
+        (std::max(boundary.p.x, boundary.q.x) + max_distance) / cell_size
+      );
+      int32_t y0 = std::floor(
+        (std::min(boundary.p.y, boundary.q.y) - max_distance) / cell_size
+      );
+      int32_t y1 = std::ceil(
+        (std::max(boundary.p.y, boundary.q.y) + max_distance) / cell_size
+      );
+      for (int32_t y = y0; y <= y1; y++) {
+        for (int32_t x = x0; x <= x1; x++) {
+          geometry::Vector<float> vertex(x * cell_size, y * cell_size);
+          float distance = get_segment_distance(vertex, boundary);
+          if (distance < max_distance) {
+            auto& value = get_vertex_ref(x, y);
+            value = std::min(value, distance);
+          }
+        }
+      }
+    }
+  }
+
+  float World::DistanceField::get_vertex(int32_t x, int32_t y) const {
+    auto it = blocks.find(get_distance_block_key(x, y));
+    if (it == blocks.end()) {
+      return max_distance;
+    }
+    return it->second[get_distance_vertex_index(x, y)];
+  }
+
+  float& World::DistanceField::get_vertex_ref(int32_t x, int32_t y) {
+    auto& block = blocks[get_distance_block_key(x, y)];
+    if (block.empty()) {
+      block.resize(distance_block_size * distance_block_size, max_distance);
+    }
+    return block[get_distance_vertex_index(x, y)];
+  }
+
+  float World::DistanceField::distance_to_boundary(
+    const geometry::Vector<float>& point
+  ) const {
+    float fx = point.x / cell_size;
+    float fy = point.y / cell_size;
+    int32_t x = std::floor(fx);
+    int32_t y = std::floor(fy);
+    float tx = fx - x;
+    float ty = fy - y;
+    float top = get_vertex(x, y) * (1 - tx) + get_vertex(x + 1, y) * tx;
+    float bottom = get_vertex(x, y + 1) * (1 - tx)
+      + get_vertex(x + 1, y + 1) * tx;
+    return std::min(top * (1 - ty) + bottom * ty, max_distance);
+  }
+
+  geometry::Vector<float> World::DistanceField::distance_gradient(
+    const geometry::Vector<float>& point
+  ) const {
+    float fx = point.x / cell_size;
+    float fy = point.y / cell_size;
+    int32_t x = std::floor(fx);
+    int32_t y = std::floor(fy);
+    float tx = fx - x;
+    float ty = fy - y;
+    float d00 = get_vertex(x, y);
+    float d10 = get_vertex(x + 1, y);
+    float d01 = get_vertex(x, y + 1);
+    float d11 = get_vertex(x + 1, y + 1);
+    return geometry::Vector<float>(
+      ((d10 - d00) * (1 - ty) + (d11 - d01) * ty) / cell_size,
+      ((d01 - d00) * (1 - tx) + (d11 - d10) * tx) / cell_size
+    );
+  }
+
+  float World::DistanceField::clearance(
+    const geometry::Vector<float>& point
+  ) const {
+    // The distance to a boundary changes by at most the distance moved, so
+    // each surrounding vertex bounds the distance at the point from below.
+    int32_t x = std::floor(point.x / cell_size);
+    int32_t y = std::floor(point.y / cell_size);
+    float result = 0;
+    for (int32_t j = 0; j < 2; j++) {
+      for (int32_t i = 0; i < 2; i++) {
+        geometry::Vector<float> vertex(
+          (x + i) * cell_size,
+          (y + j) * cell_size
+        );
+        result = std::max(
+          result,
+          get_vertex(x + i, y + j) - (point - vertex).length()
+        );
+      }
+    }
+    return result;
+  }
+
+  float World::DistanceField::get_max_distance() const {
+    return max_distance;
+  }
+
+  static bool can_skip_static_boundaries(
+    const World::DistanceField& distance_field,
+    const Tileset::Tile::CollisionBox<float>& box,
+    const geometry::Vector<float>& force
+  ) {
+    // Every point swept by the box lies within its half diagonal plus the
+    // force length of its center. The extra pixel covers the intersection
+    // tolerance.
+    auto half_size = box.size / 2.f;
+    return distance_field.clearance(box.position + half_size)
+      > half_size.length() + force.length() + 1;
+  }
+
+  template <typename Visitor>
+  static void sweep_boundaries(
     geometry::Vector<float> force,
     const Tileset::Tile::CollisionBox<float> collision_boxes[],
     size_t collision_boxes_count,
-    const World::Boundaries& boundaries
+    const World::Boundaries& boundaries,
+    const World::DistanceField* distance_field,
+    size_t static_count,
+    uint8_t layers,
+    World::CollisionStats& stats,
+    Visitor visit
   ) {
-    BoundaryCollision closest = {{.distance = geometry::Vector<float>::NaN()}};
+    using Collision = World::Collision;
     if (force.x != 0 || force.y != 0) {
       for (size_t i = 0; i < collision_boxes_count; i++) {
         const auto& box = collision_boxes[i];
         auto pos = box.position;
+        // Static boundaries precede dynamic boundaries. If the box cannot
+        // reach any static boundary, only the dynamic boundaries are scanned.
+        auto first = first_boundary(boundaries, force);
+        auto last = last_boundary(boundaries, force);
+        if (distance_field
+            && can_skip_static_boundaries(*distance_field, box, force)) {
+          if (force.x > 0) {
+            first = static_count;
+          } else {
+            last = static_count - 1;
+          }
+        }
+        // Only boundaries within the bounds of the box and its transit can
+        // collide with the box.
+        auto bounds = quantize_bounds(
+          boundaries,
+          pos + geometry::Vector<float>(
+            std::min(force.x, 0.f),
+            std::min(force.y, 0.f)
+          ),
+          pos + box.size + geometry::Vector<float>(
+            std::max(force.x, 0.f),
+            std::max(force.y, 0.f)
+          )
+        );
+        auto quantized = boundaries.get_quantized();
         // Check for intersections between boundaries and the transits of the
         // bounding box corners to their new positions.
-        typename World::Boundaries::const_iterator curr;
-        if (force.x > 0) {
-          curr = boundaries.cbegin();
-        } else {
-          curr = std::prev(boundaries.cend());
-        }
-        while (curr != boundaries.cend()) {
+        for (auto n = first; n != last; next_boundary(n, force)) {
+          COLLISION_STAT(stats, boundaries_visited);
+          if (!(quantized[n].layers & layers)
+              || is_outside(quantized[n], bounds)) {
+            continue;
+          }
+          const auto* curr = &boundaries[n];
           const auto& p = curr->p;
           const auto& q = curr->q;
           geometry::Vector<float> corners[4] = {
@@ -450,6 +1333,7 @@ namespace ultra {
               if ((p.x <= q.x || p.y != q.y)
                   && (p.x != q.x || p.y >= q.y)
                   && (p.x <= q.x || p.y >= q.y)) {
+                COLLISION_STAT(stats, direction_rejects);
                 continue;
               }
               if (curr->slope() == std::numeric_limits<float>::infinity()
@@ -461,6 +1345,7 @@ namespace ultra {
               if ((p.x <= q.x || p.y != q.y)
                   && (p.x != q.x || p.y <= q.y)
                   && (p.x <= q.x || p.y <= q.y)) {
+                COLLISION_STAT(stats, direction_rejects);
                 continue;
               }
               if (curr->slope() == std::numeric_limits<float>::infinity()
@@ -472,6 +1357,7 @@ namespace ultra {
               if ((p.x >= q.x || p.y != q.y)
                   && (p.x != q.x || p.y <= q.y)
                   && (p.x >= q.x || p.y <= q.y)) {
+                COLLISION_STAT(stats, direction_rejects);
                 continue;
               }
               if (curr->slope() == std::numeric_limits<float>::infinity()
@@ -483,6 +1369,7 @@ namespace ultra {
               if ((p.x >= q.x || p.y != q.y)
                   && (p.x != q.x || p.y >= q.y)
                   && (p.x >= q.x || p.y >= q.y)) {
+                COLLISION_STAT(stats, direction_rejects);
                 continue;
               }
               if (curr->slope() == std::numeric_limits<float>::infinity()
@@ -491,6 +1378,7 @@ namespace ultra {
               }
               break;
             }
+            COLLISION_STAT(stats, intersection_tests);
             auto intersection = curr->intersection(segment, epsilon);
             if (!intersection.is_nan()) {
               // Ignore tangential forces intersecting at a boundary edge.
@@ -504,62 +1392,54 @@ namespace ultra {
                 }
               }
               auto dst = intersection - corner;
-              if (closest.distance.is_nan()
-                  || dst.length() < closest.distance.length()) {
-                switch (j) {
-                case 0:
-                  if (curr->slope()
-                      == std::numeric_limits<float>::infinity()) {
-                    closest.edge = Collision::Edge::Left;
-                  } else {
-                    closest.edge = Collision::Edge::Top;
-                  }
-                  break;
-                case 1:
-                  if (curr->slope()
-                      == std::numeric_limits<float>::infinity()) {
-                    closest.edge = Collision::Edge::Right;
-                  } else {
-                    closest.edge = Collision::Edge::Top;
-                  }
-                  break;
-                case 2:
-                  if (curr->slope()
-                      == std::numeric_limits<float>::infinity()) {
-                    closest.edge = Collision::Edge::Right;
-                  } else {
-                    closest.edge = Collision::Edge::Bottom;
-                  }
-                  break;
-                case 3:
-                  if (curr->slope()
-                      == std::numeric_limits<float>::infinity()) {
-                    closest.edge = Collision::Edge::Left;
-                  } else {
-                    closest.edge = Collision::Edge::Bottom;
-                  }
-                  break;
+              Collision::Edge edge;
+              switch (j) {
+              case 0:
+                if (curr->slope()
+                    == std::numeric_limits<float>::infinity()) {
+                  edge = Collision::Edge::Left;
+                } else {
+                  edge = Collision::Edge::Top;
+                }
+                break;
+              case 1:
+                if (curr->slope()
+                    == std::numeric_limits<float>::infinity()) {
+                  edge = Collision::Edge::Right;
+                } else {
+                  edge = Collision::Edge::Top;
+                }
+                break;
+              case 2:
+                if (curr->slope()
+                    == std::numeric_limits<float>::infinity()) {
+                  edge = Collision::Edge::Right;
+                } else {
+                  edge = Collision::Edge::Bottom;
+                }
+                break;
+              case 3:
+                if (curr->slope()
+                    == std::numeric_limits<float>::infinity()) {
+                  edge = Collision::Edge::Left;
+                } else {
+                  edge = Collision::Edge::Bottom;
                 }
-                closest.name = box.name;
-                closest.distance = dst;
-                closest.boundary = curr;
+                break;
               }
+              visit(edge, box.name, dst, n, curr);
             }
           }
-          if (force.x > 0) {
-            curr++;
-          } else {
-            curr--;
-          }
         }
         // Check for boundaries within the transits of the edges to their new
         // positions.
-        if (force.x > 0) {
-          curr = boundaries.cbegin();
-        } else {
-          curr = std::prev(boundaries.cend());
-        }
-        while (curr != boundaries.cend()) {
+        for (auto n = first; n != last; next_boundary(n, force)) {
+          COLLISION_STAT(stats, boundaries_visited);
+          if (!(quantized[n].layers & layers)
+              || is_outside(quantized[n], bounds)) {
+            continue;
+          }
+          const auto* curr = &boundaries[n];
           const auto& p = curr->p;
           const auto& q = curr->q;
           if (force.y == 0) {
@@ -575,13 +1455,7 @@ namespace ultra {
                 auto pdst = (pos - p).as_x();
                 auto qdst = (pos - q).as_x();
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Left;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Left, box.name, dst, n, curr);
               }
             } else if (force.x > 0) {
               if (p.x >= pos.x + box.size.x
@@ -595,13 +1469,7 @@ namespace ultra {
                 auto pdst = (p - pos - box.size).as_x();
                 auto qdst = (q - pos - box.size).as_x();
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Right;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Right, box.name, dst, n, curr);
               }
             }
           } else if (force.x == 0) {
@@ -617,13 +1485,7 @@ namespace ultra {
                 auto pdst = (pos - p).as_y();
                 auto qdst = (pos - q).as_y();
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Top;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Top, box.name, dst, n, curr);
               }
             } else if (force.y > 0) {
               if (p.y >= pos.y + box.size.y
@@ -637,13 +1499,7 @@ namespace ultra {
                 auto pdst = (p - pos - box.size).as_y();
                 auto qdst = (q - pos - box.size).as_y();
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Bottom;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Bottom, box.name, dst, n, curr);
               }
             }
           } else if (force.y < 0) {
@@ -666,13 +1522,7 @@ namespace ultra {
                 q.y
               ) - left.q;
               auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-              if (closest.distance.is_nan()
-                  || dst.length() < closest.distance.length()) {
-                closest.edge = Collision::Edge::Top;
-                closest.name = box.name;
-                closest.distance = dst;
-                closest.boundary = curr;
-              }
+              visit(Collision::Edge::Top, box.name, dst, n, curr);
             }
             if (force.x < 0) {
               auto bottom = left + box.size.as_y();
@@ -693,13 +1543,7 @@ namespace ultra {
                   left.to_line().y_from_x(q.x)
                 ) - left.q;
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Left;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Left, box.name, dst, n, curr);
               }
             } else {
               auto bottom = right + box.size.as_y();
@@ -720,13 +1564,7 @@ namespace ultra {
                   right.to_line().y_from_x(q.x)
                 ) - right.q;
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Right;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Right, box.name, dst, n, curr);
               }
             }
           } else {
@@ -752,13 +1590,7 @@ namespace ultra {
                 q.y
               ) - left.q;
               auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-              if (closest.distance.is_nan()
-                  || dst.length() < closest.distance.length()) {
-                closest.edge = Collision::Edge::Bottom;
-                closest.name = box.name;
-                closest.distance = dst;
-                closest.boundary = curr;
-              }
+              visit(Collision::Edge::Bottom, box.name, dst, n, curr);
             }
             if (force.x < 0) {
               auto top = left - box.size.as_y();
@@ -779,13 +1611,7 @@ namespace ultra {
                   left.to_line().y_from_x(q.x)
                 ) - left.q;
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Left;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Left, box.name, dst, n, curr);
               }
             } else {
               auto top = right - box.size.as_y();
@@ -806,51 +1632,426 @@ namespace ultra {
                   right.to_line().y_from_x(q.x)
                 ) - right.q;
                 auto dst = pdst.length() < qdst.length() ? pdst : qdst;
-                if (closest.distance.is_nan()
-                    || dst.length() < closest.distance.length()) {
-                  closest.edge = Collision::Edge::Right;
-                  closest.name = box.name;
-                  closest.distance = dst;
-                  closest.boundary = curr;
-                }
+                visit(Collision::Edge::Right, box.name, dst, n, curr);
               }
             }
           }
-          if (force.x > 0) {
-            curr++;
-          } else {
-            curr--;
-          }
         }
       }
     }
+  }
+
+  std::pair<bool, World::BoundaryCollision> World::get_boundary_collision(
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    uint8_t layers
+  ) {
+    return get_boundary_collision(
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      nullptr,
+      0,
+      layers
+    );
+  }
+
+  std::pair<bool, World::BoundaryCollision> World::get_boundary_collision(
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    const DistanceField& distance_field,
+    uint8_t layers
+  ) {
+    return get_boundary_collision(
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      &distance_field,
+      distance_field.static_count,
+      layers
+    );
+  }
+
+  std::pair<bool, World::BoundaryCollision> World::get_boundary_collision(
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    const DistanceField* distance_field,
+    size_t static_count,
+    uint8_t layers
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    BoundaryCollision closest = {{.distance = geometry::Vector<float>::NaN()}};
+    CollisionStats stats = {};
+    sweep_boundaries(
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      distance_field,
+      static_count,
+      layers,
+      stats,
+      [&](
+        Collision::Edge edge,
+        Hash name,
+        const geometry::Vector<float>& dst,
+        size_t index,
+        const Boundary* boundary
+      ) {
+        if (closest.distance.is_nan()
+            || dst.length() < closest.distance.length()) {
+          closest.edge = edge;
+          closest.name = name;
+          closest.distance = dst;
+          closest.index = index;
+          closest.boundary = boundary;
+        }
+      }
+    );
+    add_collision_stats(stats);
     if (closest.distance.is_nan()) {
       return std::make_pair(false, BoundaryCollision{});
     }
     return std::make_pair(true, closest);
   }
 
+  size_t World::get_boundary_collisions(
+    BoundaryCollision collisions[],
+    size_t collisions_count,
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    uint8_t layers
+  ) {
+    return get_boundary_collisions(
+      collisions,
+      collisions_count,
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      nullptr,
+      0,
+      layers
+    );
+  }
+
+  size_t World::get_boundary_collisions(
+    BoundaryCollision collisions[],
+    size_t collisions_count,
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    const DistanceField& distance_field,
+    uint8_t layers
+  ) {
+    return get_boundary_collisions(
+      collisions,
+      collisions_count,
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      &distance_field,
+      distance_field.static_count,
+      layers
+    );
+  }
+
+  size_t World::get_boundary_collisions(
+    BoundaryCollision collisions[],
+    size_t collisions_count,
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const World::Boundaries& boundaries,
+    const DistanceField* distance_field,
+    size_t static_count,
+    uint8_t layers
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    size_t count = 0;
+    CollisionStats stats = {};
+    sweep_boundaries(
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      distance_field,
+      static_count,
+      layers,
+      stats,
+      [&](
+        Collision::Edge edge,
+        Hash name,
+        const geometry::Vector<float>& dst,
+        size_t index,
+        const Boundary* boundary
+      ) {
+        auto length = dst.length();
+        // A box may reach the same boundary through several of its corners
+        // and edges. Only the closest of those contacts is kept.
+        for (size_t i = 0; i < count; i++) {
+          if (collisions[i].name == name
+              && collisions[i].index == index) {
+            if (length >= collisions[i].distance.length()) {
+              return;
+            }
+            std::move(&collisions[i + 1], &collisions[count], &collisions[i]);
+            count--;
+            break;
+          }
+        }
+        // Insert the contact after any contacts of equal distance so that the
+        // first contact matches the result of get_boundary_collision.
+        size_t slot = count;
+        while (slot > 0 && length < collisions[slot - 1].distance.length()) {
+          slot--;
+        }
+        if (slot >= collisions_count) {
+          return;
+        }
+        if (count == collisions_count) {
+          count--;
+        }
+        std::move_backward(
+          &collisions[slot],
+          &collisions[count],
+          &collisions[count + 1]
+        );
+        count++;
+        collisions[slot].edge = edge;
+        collisions[slot].name = name;
+        collisions[slot].distance = dst;
+        collisions[slot].index = index;
+        collisions[slot].boundary = boundary;
+      }
+    );
+    add_collision_stats(stats);
+    return count;
+  }
+
   World::Boundary::Boundary()
     : geometry::LineSegment<float>(),
-      flags(0) {}
+      flags(0),
+      layers(default_layers) {}
 
   World::Boundary::Boundary(
     const geometry::Vector<float>& p,
     const geometry::Vector<float>& q
   ) : geometry::LineSegment<float>(p, q),
-      flags(0) {}
+      flags(0),
+      layers(default_layers) {}
 
   World::Boundary::Boundary(
     uint8_t flags,
     const geometry::Vector<float>& p,
     const geometry::Vector<float>& q
   ) : geometry::LineSegment<float>(p, q),
-      flags(flags) {}
+      flags(flags),
+      layers(default_layers) {}
+
+  World::Boundary::Boundary(
+    uint8_t flags,
+    uint8_t layers,
+    const geometry::Vector<float>& p,
+    const geometry::Vector<float>& q
+  ) : geometry::LineSegment<float>(p, q),
+      flags(flags),
+      layers(layers) {}
+
+  World::RestingContact::RestingContact()
+    : boundaries(nullptr),
+      version(0),
+      layers(0),
+      sleeping(false) {}
+
+  std::pair<bool, World::BoundaryCollision>
+  World::RestingContact::get_boundary_collision(
+    geometry::Vector<float> force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const Boundaries& boundaries,
+    uint8_t layers
+  ) {
+    ALLOCATION_SCOPE(Collision);
+    if (is_unchanged(
+          force,
+          collision_boxes,
+          collision_boxes_count,
+          boundaries,
+          layers
+        )) {
+      sleeping = true;
+      return result;
+    }
+    sleeping = false;
+    result = World::get_boundary_collision(
+      force,
+      collision_boxes,
+      collision_boxes_count,
+      boundaries,
+      layers
+    );
+    this->collision_boxes.assign(
+      collision_boxes,
+      collision_boxes + collision_boxes_count
+    );
+    this->force = force;
+    this->boundaries = &boundaries;
+    this->version = boundaries.get_version();
+    this->layers = layers;
+    return result;
+  }
+
+  bool World::RestingContact::is_sleeping() const {
+    return sleeping;
+  }
+
+  void World::RestingContact::wake() {
+    boundaries = nullptr;
+    sleeping = false;
+  }
+
+  bool World::RestingContact::is_unchanged(
+    const geometry::Vector<float>& force,
+    const Tileset::Tile::CollisionBox<float> collision_boxes[],
+    size_t collision_boxes_count,
+    const Boundaries& boundaries,
+    uint8_t layers
+  ) const {
+    if (this->boundaries != &boundaries
+        || this->layers != layers
+        || !(this->force == force)
+        || this->collision_boxes.size() != collision_boxes_count) {
+      return false;
+    }
+    for (size_t i = 0; i < collision_boxes_count; i++) {
+      const auto& prev = this->collision_boxes[i];
+      const auto& next = collision_boxes[i];
+      if (prev.name != next.name
+          || !(prev.position == next.position)
+          || !(prev.size == next.size)) {
+        return false;
+      }
+    }
+    // Only boundaries within the bounds of the boxes and their transits can
+    // change the result.
+    geometry::Vector<float> min(
+      std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::infinity()
+    );
+    auto max = min * -1.f;
+    for (size_t i = 0; i < collision_boxes_count; i++) {
+      const auto& box = collision_boxes[i];
+      min.x = std::min(min.x, box.position.x + std::min(force.x, 0.f));
+      min.y = std::min(min.y, box.position.y + std::min(force.y, 0.f));
+      max.x = std::max(
+        max.x,
+        box.position.x + box.size.x + std::max(force.x, 0.f)
+      );
+      max.y = std::max(
+        max.y,
+        box.position.y + box.size.y + std::max(force.y, 0.f)
+      );
+    }
+    return boundaries.is_unchanged(version, min, max);
+  }
 
   const World::Boundaries& World::get_boundaries() const {
     return *boundaries;
   }
 
+  void World::bake_distance_field(float cell_size, float max_distance) {
+    distance_field.reset(
+      new DistanceField(*boundaries, cell_size, max_distance)
+    );
+  }
+
+  const World::DistanceField* World::get_distance_field() const {
+    return distance_field.get();
+  }
+
+  const World::DynamicBoundaries* World::add_dynamic_boundaries(
+    const geometry::Vector<float> points[],
+    size_t points_count,
+    const geometry::Vector<float>& position,
+    uint8_t flags,
+    uint8_t layers
+  ) {
+    if (points_count < 2) {
+      throw error(__FILE__, __LINE__, "dynamic boundaries need two points");
+    }
+    flags |= Boundary::Flags::Dynamic;
+    ScopedArena scratch;
+    auto segments = scratch.allocate<Boundary>(points_count - 1);
+    for (size_t i = 1; i < points_count; i++) {
+      new (&segments[i - 1]) Boundary(
+        flags,
+        layers,
+        points[i - 1] + position,
+        points[i] + position
+      );
+    }
+    // Register the handle before inserting the segments, so that nothing
+    // throws after they are inserted.
+    auto set = std::make_unique<DynamicBoundaries>(DynamicBoundaries {
+      .index = 0,
+      .points = std::vector<geometry::Vector<float>>(
+        points,
+        points + points_count
+      ),
+      .position = position,
+    });
+    DynamicBoundaries* handle = set.get();
+    auto it = dynamic_boundaries.emplace(handle, std::move(set)).first;
+    try {
+      handle->index = boundaries->insert(segments, points_count - 1);
+    } catch (...) {
+      dynamic_boundaries.erase(it);
+      throw;
+    }
+    return handle;
+  }
+
+  void World::set_dynamic_boundaries_position(
+    const DynamicBoundaries* handle,
+    const geometry::Vector<float>& position
+  ) {
+    auto& set = *dynamic_boundaries.at(handle);
+    set.position = position;
+    // Update the line segments of the set in place.
+    for (size_t i = 1; i < set.points.size(); i++) {
+      boundaries->set(
+        set.index + i - 1,
+        set.points[i - 1] + position,
+        set.points[i] + position
+      );
+    }
+  }
+
+  const geometry::Vector<float>& World::get_dynamic_boundaries_position(
+    const DynamicBoundaries* handle
+  ) const {
+    return dynamic_boundaries.at(handle)->position;
+  }
+
+  void World::remove_dynamic_boundaries(const DynamicBoundaries* handle) {
+    auto& set = *dynamic_boundaries.at(handle);
+    boundaries->erase(set.index, set.points.size() - 1);
+    dynamic_boundaries.erase(handle);
+  }
+
   World::Map::Map(std::istream& stream) {
     // Read map position in world.
     position.x = util::read<int16_t>(stream);
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace ultra::world {
+
+  void advance();
+
+}